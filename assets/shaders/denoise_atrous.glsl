@@ -0,0 +1,171 @@
+#version 460 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "pt_gbuffer.glsl"
+
+// Денойзер в духе SVGF: фильтруется освещённость (цвет, делённый на альбедо), чтобы текстуры не мылились.
+// u_pass = 0 - оценка дисперсии: демодуляция + дисперсия из моментов (или по соседям, пока сэмплов мало).
+// u_pass > 0 - проходы а-труа: ядро 5x5 с шагом u_step (1, 2, 4, 8, 16), веса по яркости, нормали,
+// глубине, objId и альбедо. В альфе едет дисперсия, последний проход умножает обратно на альбедо
+
+layout(rgba32f, binding = 0) uniform writeonly image2D u_output;
+
+uniform sampler2D u_input;   // rgb - освещённость, a - её дисперсия (выход прошлого прохода)
+uniform sampler2D u_color;   // Накопленный цвет, в альфе число сэмплов
+uniform sampler2D u_moments; // Среднее квадрата яркости
+uniform sampler2D u_gbuffer;
+uniform sampler2D u_albedo;
+
+uniform ivec2 u_size;        // Рендер занимает левый нижний угол текстур (динамическое разрешение)
+uniform int u_pass;
+uniform int u_step;
+uniform int u_last;
+uniform float u_sigmaColor;  // Сколько стандартных отклонений яркости ещё считается одной поверхностью
+uniform float u_sigmaNormal; // Степень косинуса между нормалями
+uniform float u_sigmaDepth;  // Допуск по глубине в долях её градиента
+uniform float u_sigmaAlbedo;
+
+const float ALBEDO_EPS = 0.02;  // Чёрные поверхности не делим на ноль
+const float kernelWeights[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+bool inside(ivec2 q) {
+    return q.x >= 0 && q.y >= 0 && q.x < u_size.x && q.y < u_size.y;
+}
+
+vec3 demodulation(ivec2 q) {
+    return max(texelFetch(u_albedo, q, 0).rgb, vec3(ALBEDO_EPS));
+}
+
+// Все гиды пикселя разом
+struct Guide {
+    vec3 n;
+    float t;
+    int objId;
+    vec3 albedo;
+};
+
+Guide loadGuide(ivec2 q) {
+    vec4 g = texelFetch(u_gbuffer, q, 0);
+    Guide r;
+    r.n = octDecode(g.xy);
+    r.t = g.z;
+    r.objId = int(g.w);
+    r.albedo = texelFetch(u_albedo, q, 0).rgb;
+    return r;
+}
+
+// Вес соседа только по геометрии и материалу, без яркости
+float guideWeight(Guide c, Guide s, vec2 depthGrad, vec2 offset) {
+    if (c.objId != s.objId) return 0.0;
+    if (c.objId < 0) return 1.0; // Небо и гизмо - плоские, дальше сравнивать нечего
+
+    float wNormal = pow(max(dot(c.n, s.n), 0.0), u_sigmaNormal);
+    float wDepth = exp(-abs(c.t - s.t) / (u_sigmaDepth * dot(depthGrad, abs(offset)) + 1e-3 * c.t));
+    vec3 da = c.albedo - s.albedo;
+    float wAlbedo = exp(-dot(da, da) / (u_sigmaAlbedo * u_sigmaAlbedo));
+    return wNormal * wDepth * wAlbedo;
+}
+
+// Градиент глубины на пиксель: меньшая из односторонних разностей, чтобы край не раздувал допуск
+vec2 depthGradient(ivec2 p, float t) {
+    vec2 g = vec2(1e10);
+    for (int i = -1; i <= 1; i += 2) {
+        ivec2 qx = p + ivec2(i, 0), qy = p + ivec2(0, i);
+        if (inside(qx)) g.x = min(g.x, abs(texelFetch(u_gbuffer, qx, 0).z - t));
+        if (inside(qy)) g.y = min(g.y, abs(texelFetch(u_gbuffer, qy, 0).z - t));
+    }
+    return min(g, vec2(t));
+}
+
+void estimateVariance(ivec2 p) {
+    vec4 accum = texelFetch(u_color, p, 0);
+    vec3 albedo = demodulation(p);
+    vec3 illum = accum.rgb / albedo;
+    float n = accum.a;
+    float scale = 1.0 / max(luma(albedo), ALBEDO_EPS);
+
+    // Дисперсия среднего по накопленным сэмплам
+    float l = luma(accum.rgb);
+    float variance = max(texelFetch(u_moments, p, 0).r - l * l, 0.0) / max(n - 1.0, 1.0);
+
+    // Пока сэмплов мало, оценка по времени ненадёжна - берём разброс по соседям той же поверхности
+    if (n < 4.0) {
+        Guide c = loadGuide(p);
+        vec2 grad = depthGradient(p, c.t);
+        float sumW = 0.0, m1 = 0.0, m2 = 0.0;
+        for (int y = -2; y <= 2; y++) {
+            for (int x = -2; x <= 2; x++) {
+                ivec2 q = p + ivec2(x, y);
+                if (!inside(q)) continue;
+                float w = guideWeight(c, loadGuide(q), grad, vec2(x, y));
+                float lq = luma(texelFetch(u_color, q, 0).rgb);
+                sumW += w;
+                m1 += w * lq;
+                m2 += w * lq * lq;
+            }
+        }
+        m1 /= sumW;
+        // Разброс по соседям - дисперсия одного сэмпла; с запасом, пока истории почти нет
+        variance = max(m2 / sumW - m1 * m1, 0.0) * 4.0 / max(n, 1.0);
+    }
+
+    imageStore(u_output, p, vec4(illum, variance * scale * scale));
+}
+
+// Дисперсия в центре сглаженная 3x3 гауссом - иначе сама шумит и рвёт фильтр
+float filteredVariance(ivec2 p) {
+    const float k[2] = float[2](0.5, 0.25);
+    float sum = 0.0, sumW = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 q = p + ivec2(x, y);
+            if (!inside(q)) continue;
+            float w = k[abs(x)] * k[abs(y)];
+            sum += w * texelFetch(u_input, q, 0).a;
+            sumW += w;
+        }
+    }
+    return sum / sumW;
+}
+
+void atrous(ivec2 p) {
+    vec4 center = texelFetch(u_input, p, 0);
+    Guide c = loadGuide(p);
+    vec2 grad = depthGradient(p, c.t);
+    float lCenter = luma(center.rgb);
+    float lScale = 1.0 / (u_sigmaColor * sqrt(filteredVariance(p)) + 1e-4);
+
+    vec3 sumColor = vec3(0.0);
+    float sumVariance = 0.0, sumW = 0.0;
+    for (int y = -2; y <= 2; y++) {
+        for (int x = -2; x <= 2; x++) {
+            ivec2 q = p + ivec2(x, y) * u_step;
+            if (!inside(q)) continue;
+            vec4 s = texelFetch(u_input, q, 0);
+            float w = kernelWeights[abs(x)] * kernelWeights[abs(y)];
+            if (x != 0 || y != 0) {
+                w *= guideWeight(c, loadGuide(q), grad, vec2(x, y) * float(u_step));
+                w *= exp(-abs(luma(s.rgb) - lCenter) * lScale);
+            }
+            sumColor += w * s.rgb;
+            sumVariance += w * w * s.a;
+            sumW += w;
+        }
+    }
+
+    vec4 result = vec4(sumColor / sumW, sumVariance / (sumW * sumW));
+    if (u_last != 0) result = vec4(result.rgb * demodulation(p), 1.0);
+    imageStore(u_output, p, result);
+}
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (!inside(p)) return;
+
+    if (u_pass == 0) estimateVariance(p);
+    else atrous(p);
+}
@@ -0,0 +1,38 @@
+// Адаптивная выборка (AdaptiveSampler.h): маска тайлов 8x8, которым ещё нужны сэмплы,
+// и накопление с числом сэмплов пикселя в альфе. Маску строит pt_adaptive_mask.glsl по накопленному,
+// pt_fragment.glsl и волновой трассировщик пропускают погасшие тайлы
+
+layout(std430, binding = 21) buffer TileMask {
+    uint activeTileCount; // Сколько тайлов осталось, для интерфейса
+    uint tileMask[];      // 1 - тайлу нужны сэмплы
+};
+
+uniform int u_adaptive; // 0 - маски нет, сэмплы получают все пиксели
+
+const int ADAPTIVE_TILE = 8;
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+int tileIndex(ivec2 pixel) {
+    int tilesX = (int(u_resolution.x) + ADAPTIVE_TILE - 1) / ADAPTIVE_TILE;
+    ivec2 tile = pixel / ADAPTIVE_TILE;
+    return tile.y * tilesX + tile.x;
+}
+
+// Пиксель под курсором трассируется всегда: по нему обновляется hoverId
+bool pixelNeedsSample(ivec2 pixel) {
+    if (u_adaptive == 0) return true;
+    if (pixel == ivec2(u_mousePos)) return true;
+    return tileMask[tileIndex(pixel)] != 0u;
+}
+
+// Новое накопленное: цвет - среднее за n сэмплов, альфа - n, момент - среднее квадрата яркости.
+// reset - первый сэмпл после сброса накопления
+void accumulateSample(vec4 lastColor, float lastMoment, vec3 color, bool reset, out vec4 outColor, out float outMoment) {
+    float n = reset ? 1.0 : lastColor.a + 1.0;
+    outColor = vec4(mix(lastColor.rgb, color, 1.0 / n), n);
+    float l = luminance(color);
+    outMoment = mix(lastMoment, l * l, 1.0 / n);
+}
@@ -0,0 +1,40 @@
+#version 460 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "pt_common.glsl"
+#include "pt_adaptive.glsl"
+
+uniform sampler2D u_sample;  // Накопленный цвет, в альфе число сэмплов
+uniform sampler2D u_moments; // Среднее квадрата яркости
+uniform float u_minSamples;  // Раньше шум не оценивается
+uniform float u_threshold;   // Допустимая относительная ошибка среднего
+
+shared bool tileNeedsSamples;
+
+// Один запуск группы на тайл: тайл активен, если хоть у одного пикселя стандартная ошибка среднего выше порога
+void main() {
+    if (gl_LocalInvocationIndex == 0u) tileNeedsSamples = false;
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(u_resolution);
+    if (pixel.x < size.x && pixel.y < size.y) {
+        vec4 accum = texelFetch(u_sample, pixel, 0);
+        float n = accum.a;
+        bool noisy = n < u_minSamples;
+        if (!noisy) {
+            float mean = luminance(accum.rgb);
+            float variance = max(texelFetch(u_moments, pixel, 0).r - mean * mean, 0.0) * n / (n - 1.0);
+            // Тёмные пиксели не гоняем до бесконечности: ошибка относительно яркости с небольшим полом
+            noisy = sqrt(variance / n) > u_threshold * (mean + 0.05);
+        }
+        if (noisy) tileNeedsSamples = true;
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0u) {
+        uint tile = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+        tileMask[tile] = tileNeedsSamples ? 1u : 0u;
+        if (tileNeedsSamples) atomicAdd(activeTileCount, 1u);
+    }
+}
@@ -0,0 +1,573 @@
+// Общий код трассировки: параметры кадра, буферы сцены, пересечения.
+// Подключается в pt_fragment.glsl и в ядра волнового трассировщика (pt_wf_*.glsl)
+
+// Параметры кадра (FrameUniforms.h), заливаются раз в кадр
+layout(std140, binding = 0) uniform FrameUniforms {
+    mat4 u_view;
+    vec3 u_pos; float floorSize;
+    vec2 u_resolution;
+    vec2 u_mousePos;
+    int u_useRayTracing;
+    int u_showLightGizmos;
+    int u_selectedId;
+    int u_geometryFormat; // GEOMETRY_*
+    int u_maxBounces;
+    int u_lightSamples;   // Теневых лучей на точку через дерево источников, 0 - по лучу на каждый источник
+    int u_samplerType;    // SAMPLER_* из pt_sampler.glsl
+};
+
+uniform sampler2D u_floorTex;
+const int MATERIAL_TEX_BUCKETS = 4; // MATERIAL_TEX_BUCKETS в GPUMeshTriangle.h
+uniform sampler2DArray u_materialTex[MATERIAL_TEX_BUCKETS]; // Base color материалов glTF по корзинам размера, с мипами
+
+const int GEOMETRY_FULL = 0;      // Triangle: три копии вершин
+const int GEOMETRY_QUANTIZED = 1; // QuantTriangle: uint16 относительно AABB объекта
+const int GEOMETRY_INDEXED = 2;   // IndexedTriangle + общий массив вершин
+
+// --- ПЕРМУТАЦИИ ---
+// ShaderPermutations подставляет PERM_* через #define, тогда ветки сворачиваются в константы
+// и неиспользуемые фичи выкидываются компилятором. Без define значения берутся из FrameUniforms
+#ifdef PERM_RAY_TRACING
+#define RAY_TRACING PERM_RAY_TRACING
+#else
+#define RAY_TRACING u_useRayTracing
+#endif
+
+#ifdef PERM_LIGHT_GIZMOS
+#define LIGHT_GIZMOS PERM_LIGHT_GIZMOS
+#else
+#define LIGHT_GIZMOS u_showLightGizmos
+#endif
+
+#ifdef PERM_SELECTION
+#define SELECTION_ENABLED (PERM_SELECTION != 0)
+#else
+#define SELECTION_ENABLED (u_selectedId != -1)
+#endif
+
+#ifdef PERM_MAX_BOUNCES
+#define MAX_BOUNCES PERM_MAX_BOUNCES
+#else
+#define MAX_BOUNCES u_maxBounces
+#endif
+
+#ifdef PERM_LIGHT_SAMPLES
+#define LIGHT_SAMPLES PERM_LIGHT_SAMPLES
+#else
+#define LIGHT_SAMPLES u_lightSamples
+#endif
+
+#ifdef PERM_GEOMETRY_FORMAT
+#define GEOMETRY_FORMAT PERM_GEOMETRY_FORMAT
+#else
+#define GEOMETRY_FORMAT u_geometryFormat
+#endif
+
+#ifdef PERM_FLOOR_SIZE
+#define FLOOR_SIZE PERM_FLOOR_SIZE
+#else
+#define FLOOR_SIZE floorSize
+#endif
+
+// --- СТРУКТУРЫ И БУФЕРЫ ---
+
+struct Light {
+    vec3 position;
+    float radius;
+    vec3 emission;
+    float pad;
+};
+
+layout(std430, binding = 5) buffer LightBuffer {
+    Light lights[];
+};
+
+// Дерево источников (GPULightNode, LightSystem.h): дети парой child, child + 1; в листе child = ~индекс источника
+struct LightNode {
+    vec3 minBounds; float power;
+    vec3 maxBounds; int child;
+};
+
+layout(std430, binding = 18) buffer LightTreeBuffer {
+    LightNode lightNodes[];
+};
+
+struct Triangle {
+    vec3 v0; float pad1;
+    vec3 v1; float pad2;
+    vec3 v2; float pad3;
+    vec3 color; int attribId;
+};
+
+struct BVHNode {
+    vec3 minBounds; int leftFirst;
+    vec3 maxBounds; int triCount;
+};
+
+struct MeshObject {
+    vec3 minAABB; float pad1;
+    vec3 maxAABB; float pad2;
+    int bvhRootIndex;
+    int pad3, pad4, pad5;
+};
+
+// Квантованная геометрия: uint16 относительно AABB объекта (GPUQuantTriangle)
+struct QuantTriangle {
+    uint p0, p1, p2, p3, p4;
+    uint color;
+    int attribId;
+    uint pad;
+};
+
+// UV треугольника + материал (GPUTriangleAttrib / GPUMaterial)
+struct TriangleAttrib {
+    vec2 uv0, uv1, uv2;
+    int materialId;
+    int pad;
+};
+
+struct Material {
+    vec4 uvRect;      // offset.xy, scale.zw внутри слоя
+    int textureLayer;
+    int textureBucket;
+    vec2 textureSize; // Картинка в текселях
+};
+
+// Индексированная геометрия (GPUIndexedTriangle), вершины - по 3 float подряд
+struct IndexedTriangle {
+    uint i0, i1, i2;
+    uint color;
+    int attribId;
+};
+
+layout(std430, binding = 2) buffer MeshBuffer { Triangle triangles[]; };
+layout(std430, binding = 7) buffer QuantMeshBuffer { QuantTriangle qtriangles[]; };
+layout(std430, binding = 3) buffer ObjectBuffer { MeshObject objects[]; };
+layout(std430, binding = 4) buffer BVHBuffer { BVHNode bvhNodes[]; };
+layout(std430, binding = 8) buffer AttribBuffer { TriangleAttrib attribs[]; };
+layout(std430, binding = 9) buffer MaterialBuffer { Material materials[]; };
+layout(std430, binding = 10) buffer VertexBuffer { float vertexData[]; };
+layout(std430, binding = 11) buffer IndexBuffer { IndexedTriangle itriangles[]; };
+layout(std430, binding = 6) buffer SelectionBuffer {
+    int hoverId;
+};
+
+struct Hit { 
+    float t; 
+    vec3 p, n, albedo, emi; 
+    float rough;
+    int objId; 
+    int triIdx;   // -1 - не меш (пол)
+    vec2 bary;    // Барицентрики (u, v) ближайшего попадания
+    float area;   // Удвоенная площадь треугольника, для мипа текстуры
+};
+
+struct OverlayHit {
+    float t;
+    vec3 color;
+};
+
+// --- ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ ---
+
+#include "pt_sampler.glsl"
+
+const float PI = 3.14159265;
+
+float intersectAABB_dist(vec3 ro, vec3 invRd, vec3 boxMin, vec3 boxMax) {
+    vec3 tMin = (boxMin - ro) * invRd;
+    vec3 tMax = (boxMax - ro) * invRd;
+    vec3 t1 = min(tMin, tMax);
+    vec3 t2 = max(tMin, tMax);
+    float tNear = max(max(t1.x, t1.y), t1.z);
+    float tFar = min(min(t2.x, t2.y), t2.z);
+    return (tNear <= tFar && tFar > 0.0) ? tNear : 1e30;
+}
+
+float intersectTriangle(vec3 ro, vec3 rd, vec3 v0, vec3 v1, vec3 v2, out vec2 bary) {
+    bary = vec2(0.0);
+    vec3 v0v1 = v1 - v0;
+    vec3 v0v2 = v2 - v0;
+    vec3 pvec = cross(rd, v0v2);
+    float det = dot(v0v1, pvec);
+    if (abs(det) < 0.00001) return 1e10;
+    float invDet = 1.0 / det;
+    vec3 tvec = ro - v0;
+    float u = dot(tvec, pvec) * invDet;
+    if (u < 0.0 || u > 1.0) return 1e10;
+    vec3 qvec = cross(tvec, v0v1);
+    float v = dot(rd, qvec) * invDet;
+    if (v < 0.0 || u + v > 1.0) return 1e10;
+    float t = dot(v0v2, qvec) * invDet;
+    bary = vec2(u, v);
+    return (t > 0.001) ? t : 1e10;
+}
+
+// Вершины треугольника для любого формата геометрии
+vec3 fetchVertex(uint i) {
+    return vec3(vertexData[3u * i], vertexData[3u * i + 1u], vertexData[3u * i + 2u]);
+}
+
+void fetchTriangle(int triIdx, vec3 qMin, vec3 qScale, out vec3 v0, out vec3 v1, out vec3 v2) {
+    if (GEOMETRY_FORMAT == GEOMETRY_INDEXED) {
+        IndexedTriangle it = itriangles[triIdx];
+        v0 = fetchVertex(it.i0); v1 = fetchVertex(it.i1); v2 = fetchVertex(it.i2);
+    } else if (GEOMETRY_FORMAT == GEOMETRY_QUANTIZED) {
+        QuantTriangle q = qtriangles[triIdx];
+        v0 = qMin + vec3(q.p0 & 0xFFFFu, q.p0 >> 16, q.p1 & 0xFFFFu) * qScale;
+        v1 = qMin + vec3(q.p1 >> 16, q.p2 & 0xFFFFu, q.p2 >> 16) * qScale;
+        v2 = qMin + vec3(q.p3 & 0xFFFFu, q.p3 >> 16, q.p4 & 0xFFFFu) * qScale;
+    } else {
+        Triangle tri = triangles[triIdx];
+        v0 = tri.v0; v1 = tri.v1; v2 = tri.v2;
+    }
+}
+
+vec3 fetchColor(int triIdx) {
+    if (GEOMETRY_FORMAT == GEOMETRY_INDEXED) return unpackUnorm4x8(itriangles[triIdx].color).rgb;
+    if (GEOMETRY_FORMAT == GEOMETRY_QUANTIZED) return unpackUnorm4x8(qtriangles[triIdx].color).rgb;
+    return triangles[triIdx].color;
+}
+
+int fetchAttribId(int triIdx) {
+    if (GEOMETRY_FORMAT == GEOMETRY_INDEXED) return itriangles[triIdx].attribId;
+    if (GEOMETRY_FORMAT == GEOMETRY_QUANTIZED) return qtriangles[triIdx].attribId;
+    return triangles[triIdx].attribId;
+}
+
+// Индекс в массиве сэмплеров должен быть динамически однородным, а корзины у соседних лучей разные -
+// поэтому ветки с константными индексами
+vec3 sampleMaterial(int bucket, vec3 uvw, float lod) {
+    if (bucket == 0) return textureLod(u_materialTex[0], uvw, lod).rgb;
+    if (bucket == 1) return textureLod(u_materialTex[1], uvw, lod).rgb;
+    if (bucket == 2) return textureLod(u_materialTex[2], uvw, lod).rgb;
+    return textureLod(u_materialTex[3], uvw, lod).rgb;
+}
+
+// Одна выборка на ближайшее попадание. Без текстуры - множитель 1.
+// Производных у луча нет - мип по конусу луча (ray cones): площадь треугольника в текселях против площади
+// в мире плюс след пикселя на расстоянии t. Конус считается от камеры и для отскоков, там мип чуть резче нужного
+vec3 fetchTexture(Hit hit, vec3 rd) {
+    int attribId = fetchAttribId(hit.triIdx);
+    if (attribId < 0) return vec3(1.0);
+    TriangleAttrib a = attribs[attribId];
+    Material m = materials[a.materialId];
+    if (m.textureLayer < 0) return vec3(1.0);
+
+    vec2 uv = a.uv0 * (1.0 - hit.bary.x - hit.bary.y) + a.uv1 * hit.bary.x + a.uv2 * hit.bary.y;
+
+    vec2 e1 = (a.uv1 - a.uv0) * m.textureSize, e2 = (a.uv2 - a.uv0) * m.textureSize;
+    float texelArea = abs(e1.x * e2.y - e1.y * e2.x);
+    float pixelSpread = 2.0 / (1.5 * u_resolution.y); // Камера: плоскость на -1.5, полувысота 1
+    float footprint = hit.t * pixelSpread / max(abs(dot(rd, hit.n)), 0.05);
+    float lod = 0.5 * log2(max(texelArea, 1e-8) / max(hit.area, 1e-12)) + log2(footprint);
+
+    // Повтор делаем сами: картинка занимает только uvRect внутри слоя
+    uv = m.uvRect.xy + fract(uv) * m.uvRect.zw;
+    return sampleMaterial(m.textureBucket, vec3(uv, float(m.textureLayer)), max(lod, 0.0));
+}
+
+// Размер короткого стека обхода. Переполнение не страшно: вытесняются самые старые записи,
+// а за ними обход вернётся через перезапуск от корня
+const int SHORT_STACK_SIZE = 8;
+
+// Обход BVH одного объекта (то же самое на CPU - TraverseMesh в RayQuery.cpp).
+// Ближний ребёнок первым, дальний - в короткий стек вместе с расстоянием до его AABB, чтобы отсечь его при снятии.
+// Restart trail: бит уровня = ближний ребёнок на этом уровне пройден. Если нужной записи в стеке нет,
+// спускаемся заново от корня по битам trail - поэтому глубина дерева ограничена MAX_BVH_DEPTH (BVH.h), а не стеком.
+// anyHit - выход на первом треугольнике ближе tMax
+bool traverseMeshBVH(vec3 ro, vec3 rd, vec3 invRd, int rootNodeIdx, int globalObjId, bool anyHit,
+                     inout float tMax, out int hitTri, out vec2 hitBary) {
+    vec3 qMin = objects[globalObjId].minAABB;
+    vec3 qScale = (objects[globalObjId].maxAABB - qMin) / 65535.0;
+    hitTri = -1;
+    hitBary = vec2(0.0);
+
+    int stackNode[SHORT_STACK_SIZE];
+    float stackDist[SHORT_STACK_SIZE];
+    uint stackLevel[SHORT_STACK_SIZE];
+    int stackTop = 0, stackSize = 0; // Кольцевой буфер
+
+    int nodeIdx = rootNodeIdx;
+    uint level = 0x80000000u; // Бит уровня детей текущего узла
+    uint trail = 0u;
+
+    while (true) {
+        BVHNode node = bvhNodes[nodeIdx];
+        if (node.triCount > 0) {
+            for (int i = 0; i < node.triCount; i++) {
+                int triIdx = node.leftFirst + i;
+                vec3 v0, v1, v2;
+                fetchTriangle(triIdx, qMin, qScale, v0, v1, v2);
+                vec2 bary;
+                float t = intersectTriangle(ro, rd, v0, v1, v2, bary);
+                if (t < tMax) {
+                    tMax = t;
+                    hitTri = triIdx;
+                    hitBary = bary;
+                    if (anyHit) return true;
+                }
+            }
+        } else {
+            int left = node.leftFirst;
+            float dl = intersectAABB_dist(ro, invRd, bvhNodes[left].minBounds, bvhNodes[left].maxBounds);
+            float dr = intersectAABB_dist(ro, invRd, bvhNodes[left + 1].minBounds, bvhNodes[left + 1].maxBounds);
+            bool hl = dl < tMax, hr = dr < tMax;
+            if (hl || hr) {
+                if (hl && hr) {
+                    int nearIdx = dl <= dr ? left : left + 1;
+                    int farIdx = 2 * left + 1 - nearIdx;
+                    if ((trail & level) != 0u) {
+                        nodeIdx = farIdx;
+                    } else {
+                        nodeIdx = nearIdx;
+                        stackNode[stackTop] = farIdx;
+                        stackDist[stackTop] = max(dl, dr);
+                        stackLevel[stackTop] = level;
+                        stackTop = (stackTop + 1) % SHORT_STACK_SIZE;
+                        stackSize = min(stackSize + 1, SHORT_STACK_SIZE);
+                    }
+                } else {
+                    nodeIdx = hl ? left : left + 1;
+                    trail |= level;
+                }
+                level >>= 1u;
+                continue;
+            }
+        }
+
+        // Поддерево закончено: отмечаем в trail и переходим к следующему дальнему ребёнку
+        while (true) {
+            uint entered = level << 1u;
+            if (entered == 0u) return hitTri >= 0;  // Корень
+            trail &= ~(entered - 1u);
+            trail += entered;
+            if (trail == 0u) return hitTri >= 0;    // Перенос ушёл за корень - дерево пройдено
+            uint popLevel = trail & (~trail + 1u);  // Младший установленный бит
+            level = popLevel >> 1u;
+
+            int top = (stackTop + SHORT_STACK_SIZE - 1) % SHORT_STACK_SIZE;
+            if (stackSize > 0 && stackLevel[top] == popLevel) {
+                stackTop = top;
+                stackSize--;
+                if (stackDist[top] >= tMax) continue; // Дальний ребёнок дальше найденного - сразу закрываем
+                nodeIdx = stackNode[top];
+            } else {
+                stackSize = 0;
+                nodeIdx = rootNodeIdx;
+                level = 0x80000000u;
+            }
+            break;
+        }
+    }
+    return hitTri >= 0;
+}
+
+// Ближайшее попадание в объект. Нормаль и цвет считаются один раз, для итогового треугольника
+void checkMeshBVH(vec3 ro, vec3 rd, vec3 invRd, int rootNodeIdx, int globalObjId, inout Hit hit) {
+    float t = hit.t;
+    int triIdx;
+    vec2 bary;
+    if (!traverseMeshBVH(ro, rd, invRd, rootNodeIdx, globalObjId, false, t, triIdx, bary)) return;
+
+    vec3 qMin = objects[globalObjId].minAABB;
+    vec3 qScale = (objects[globalObjId].maxAABB - qMin) / 65535.0;
+    vec3 v0, v1, v2;
+    fetchTriangle(triIdx, qMin, qScale, v0, v1, v2);
+
+    hit.t = t;
+    hit.triIdx = triIdx;
+    hit.bary = bary;
+    hit.p = ro + rd * t;
+    vec3 c = cross(v1 - v0, v2 - v0);
+    hit.area = length(c);
+    hit.n = c / hit.area;
+    if(dot(rd, hit.n) > 0.0) hit.n = -hit.n;
+    hit.albedo = fetchColor(triIdx);
+    hit.emi = vec3(0);
+    // ТЕПЕРЬ ПРИСВАИВАЕМ ID ОБЪЕКТА, А НЕ ТРЕУГОЛЬНИКА
+    hit.objId = globalObjId;
+}
+
+// Any-hit для теневых лучей: выходим на первом треугольнике ближе maxT, нормали и цвет не считаем
+bool occludedMeshBVH(vec3 ro, vec3 rd, vec3 invRd, float maxT, int rootNodeIdx, int globalObjId) {
+    int triIdx;
+    vec2 bary;
+    return traverseMeshBVH(ro, rd, invRd, rootNodeIdx, globalObjId, true, maxT, triIdx, bary);
+}
+
+// Функция для отрисовки чисто визуальных штук
+void checkOverlays(vec3 ro, vec3 rd, inout OverlayHit ohit) {
+    if (LIGHT_GIZMOS == 0) return;
+
+    for(int i = 0; i < lights.length(); i++) {
+        vec3 lp = lights[i].position;
+        
+        // Рисуем сферу
+        vec3 oc = ro - lp;
+        float b = dot(oc, rd);
+        float c = dot(oc, oc) - 0.05;
+        float h = b*b - c;
+        if (h > 0.0) {
+            float t = -b - sqrt(h);
+            if (t > 0.0 && t < ohit.t) {
+                ohit.t = t;
+                ohit.color = vec3(1.0, 1.0, 1.0); // Желтый
+            }
+        }
+    }
+}
+
+void checkScene(vec3 ro, vec3 rd, inout Hit hit) {
+    hit.triIdx = -1;
+
+    // Пол (ID = 10)
+    float tp = -(ro.y + 1.0) / rd.y;
+    if(tp > 0.001 && tp < hit.t) {
+        vec3 intersectPoint = ro + rd * tp;
+        if(abs(intersectPoint.x) < FLOOR_SIZE && abs(intersectPoint.z) < FLOOR_SIZE) {
+            hit.t = tp; 
+            hit.p = intersectPoint; 
+            hit.n = vec3(0, 1, 0);
+            hit.albedo = texture(u_floorTex, hit.p.xz * 0.1).rgb;
+            hit.emi = vec3(0); 
+            hit.objId = 10;
+        }
+    }
+
+    // Меши (ID = индекс в массиве objects)
+    vec3 invRd = 1.0 / rd;
+    for(int i = 0; i < objects.length(); i++) {
+        // Сначала быстрая проверка по общему AABB объекта
+        if (intersectAABB_dist(ro, invRd, objects[i].minAABB, objects[i].maxAABB) < hit.t) {
+            // Передаем индекс 'i' как ID объекта
+            checkMeshBVH(ro, rd, invRd, objects[i].bvhRootIndex, i, hit);
+        }
+    }
+
+    // Текстуру читаем только для итогового попадания, а не для каждого кандидата в BVH
+    if (hit.triIdx >= 0) hit.albedo *= fetchTexture(hit, rd);
+}
+
+vec3 randomOnSphere() {
+    float z = 1.0 - 2.0 * rand(), r = sqrt(max(0.0, 1.0 - z*z)), phi = 2.0 * PI * rand();
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+// Есть ли что-то на отрезке [0.001, maxT] луча. Пол проверяем первым - он дешёвый и часто заслоняет
+bool isOccluded(vec3 ro, vec3 rd, float maxT) {
+    float tp = -(ro.y + 1.0) / rd.y;
+    if (tp > 0.001 && tp < maxT) {
+        vec3 p = ro + rd * tp;
+        if (abs(p.x) < FLOOR_SIZE && abs(p.z) < FLOOR_SIZE) return true;
+    }
+
+    vec3 invRd = 1.0 / rd;
+    for (int i = 0; i < objects.length(); i++) {
+        if (intersectAABB_dist(ro, invRd, objects[i].minAABB, objects[i].maxAABB) < maxT &&
+            occludedMeshBVH(ro, rd, invRd, maxT, objects[i].bvhRootIndex, i)) return true;
+    }
+    return false;
+}
+
+bool isVisible(vec3 from, vec3 to) {
+    vec3 dir = to - from;
+    float maxT = length(dir) - 0.002;
+    return !isOccluded(from, normalize(dir), maxT);
+}
+
+// Вклад точки lightPoint на источнике i без проверки видимости (ноль, если источник за поверхностью)
+vec3 lightContribution(int i, vec3 lightPoint, vec3 p, vec3 n, vec3 albedo) {
+    vec3 toLight = lightPoint - p;
+    float dist = length(toLight);
+    vec3 L = toLight / dist;
+    float NdotL = max(dot(n, L), 0.0);
+    if (NdotL <= 0.0) return vec3(0);
+
+    float lightArea = 4.0 * PI * lights[i].radius * lights[i].radius;
+    // Упрощенная модель затухания
+    float atten = lightArea / (dist * dist + 0.01);
+    return albedo * lights[i].emission * NdotL * atten * 0.1;
+}
+
+// Случайная точка на источнике i и её вклад без проверки видимости
+vec3 sampleLight(int i, vec3 p, vec3 n, vec3 albedo, out vec3 lightPoint) {
+    lightPoint = lights[i].position + randomOnSphere() * lights[i].radius;
+    return lightContribution(i, lightPoint, p, n, albedo);
+}
+
+// Важность узла дерева источников (LightNodeImportance в LightSystem.cpp): мощность * оценка косинуса сверху / расстояние^2.
+// Ноль - только если весь узел под горизонтом, тогда вклад его источников точно нулевой
+float lightNodeImportance(LightNode node, vec3 p, vec3 n) {
+    vec3 center = (node.minBounds + node.maxBounds) * 0.5;
+    float r = length(node.maxBounds - node.minBounds) * 0.5;
+    vec3 d = center - p;
+    float dist2 = dot(d, d);
+    float dist = sqrt(dist2);
+
+    float cosBound = 1.0;
+    if (dist > r) {
+        float cosTheta = dot(n, d) / dist;
+        float sinAlpha = r / dist;
+        float cosAlpha = sqrt(1.0 - sinAlpha * sinAlpha);
+        if (cosTheta < cosAlpha) {
+            float sinTheta = sqrt(max(0.0, 1.0 - cosTheta * cosTheta));
+            cosBound = cosTheta * cosAlpha + sinTheta * sinAlpha;
+        }
+    }
+    if (cosBound <= 0.0) return 0.0;
+    return node.power * cosBound / max(dist2, r * r);
+}
+
+// Спуск по дереву: на каждом узле ребёнок выбирается пропорционально важности.
+// Стоимость - глубина дерева (log n), а не число источников. -1 - все источники под горизонтом
+int sampleLightTree(vec3 p, vec3 n, out float pdf) {
+    pdf = 1.0;
+    int nodeIdx = 0;
+    while (lightNodes[nodeIdx].child >= 0) {
+        int left = lightNodes[nodeIdx].child;
+        float il = lightNodeImportance(lightNodes[left], p, n);
+        float ir = lightNodeImportance(lightNodes[left + 1], p, n);
+        if (il + ir <= 0.0) return -1;
+        float pl = il / (il + ir);
+        if (rand() < pl) {
+            nodeIdx = left;
+            pdf *= pl;
+        } else {
+            nodeIdx = left + 1;
+            pdf *= 1.0 - pl;
+        }
+    }
+    return ~lightNodes[nodeIdx].child;
+}
+
+// Сколько теневых лучей на точку: LIGHT_SAMPLES выборок из дерева или по одному на источник
+int lightSampleCount() {
+    if (lights.length() == 0) return 0;
+    return LIGHT_SAMPLES > 0 ? LIGHT_SAMPLES : lights.length();
+}
+
+// Источник для s-й выборки и вес его вклада (1 / (pdf * число выборок)). -1 - выборка пустая
+int pickLight(int s, vec3 p, vec3 n, out float weight) {
+    weight = 1.0;
+    if (LIGHT_SAMPLES == 0) return s;
+    float pdf;
+    int i = sampleLightTree(p, n, pdf);
+    weight = 1.0 / (pdf * float(LIGHT_SAMPLES));
+    return i;
+}
+
+vec3 skyColor(vec3 rd) {
+    return mix(vec3(0.5, 0.7, 1.0), vec3(1.0), rd.y * 0.5 + 0.5);
+}
+
+// Без трассировки путей: одно солнце без теней
+vec3 previewShading(vec3 albedo, vec3 n) {
+    vec3 sunDir = normalize(vec3(0.5, 1.0, 0.5));
+    return albedo * max(dot(n, sunDir), 0.2);
+}
+
+vec3 randomCosineHemisphere(vec3 n) {
+    float r1 = 2.0 * PI * rand(), r2 = rand(), r2s = sqrt(r2);
+    vec3 w = n, u = normalize(cross(abs(w.x) > 0.1 ? vec3(0,1,0) : vec3(1,0,0), w)), v = cross(w, u);
+    return normalize(u * cos(r1) * r2s + v * sin(r1) * r2s + w * sqrt(1.0 - r2));
+}
@@ -0,0 +1,23 @@
+// G-буфер первичного попадания (Framebuffer::textureGBuffer): октаэдрическая нормаль, расстояние от камеры, objId.
+// Пишут трассировщики, читают репроекция (pt_reproject.glsl) и денойзер (denoise_atrous.glsl).
+// Рядом лежит альбедо первичного попадания (Framebuffer::textureAlbedo) - ещё один гид денойзера
+
+const int GBUFFER_MISS = -1;    // Небо
+const int GBUFFER_OVERLAY = -2; // Гизмо: двигается вместе с камерой, истории у него нет
+
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e;
+}
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+vec4 packGBuffer(vec3 n, float t, int objId) {
+    return vec4(octEncode(n), t, float(objId));
+}
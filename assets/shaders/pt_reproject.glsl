@@ -0,0 +1,59 @@
+// Репроекция накопленного между кадрами (temporal reprojection).
+// Трассировщики пишут G-буфер первичного попадания (pt_gbuffer.glsl).
+// Когда камера сдвинулась, первый сэмпл кадра берёт историю не из своего пикселя, а из точки, куда
+// его попадание проецировалось прошлой камерой; соседи, видевшие другую поверхность, отбрасываются
+
+uniform mat4 u_prevView;        // Камера, которой снято накопленное
+uniform vec2 u_prevResolution;  // И в каком разрешении (меняется динамическим разрешением)
+uniform int u_reproject;        // 1 - история из прошлого кадра через репроекцию
+uniform float u_maxHistory;     // Сколько сэмплов истории переживает репроекцию (иначе размазывается)
+uniform sampler2D u_prevGBuffer;
+uniform sampler2D u_prevAlbedo;  // Гид денойзера, его только копируют в погасших тайлах
+
+#include "pt_gbuffer.glsl"
+
+// Точка p в пикселях прошлой камеры (центры пикселей на .5). (-1, -1) - за камерой
+vec2 prevPixelCoord(vec3 p) {
+    vec3 v = (u_prevView * vec4(p, 1.0)).xyz;
+    if (v.z > -1e-4) return vec2(-1.0);
+    vec2 uv = v.xy / -v.z * 1.5;
+    vec2 texCoords = (uv / vec2(u_prevResolution.x / u_prevResolution.y, 1.0) + 1.0) * 0.5;
+    return texCoords * u_prevResolution;
+}
+
+// Накопленное прошлой камерой в точке p: билинейно по четырём пикселям, без тех, что видели другую поверхность.
+// false - подходящих соседей нет (disocclusion), накопление начинается заново
+bool reprojectHistory(sampler2D colorTex, sampler2D momentsTex, vec3 p, vec3 n, int objId, out vec4 color, out float moment) {
+    color = vec4(0);
+    moment = 0.0;
+    if (objId < 0) return false;
+
+    vec2 coord = prevPixelCoord(p) - 0.5;
+    if (coord.x < -1.0) return false;
+    ivec2 base = ivec2(floor(coord));
+    vec2 f = coord - vec2(base);
+    ivec2 size = ivec2(u_prevResolution);
+    vec3 prevCamPos = -transpose(mat3(u_prevView)) * u_prevView[3].xyz;
+    float depth = distance(prevCamPos, p);
+
+    float weightSum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 q = base + offset;
+        if (any(lessThan(q, ivec2(0))) || any(greaterThanEqual(q, size))) continue;
+
+        vec4 g = texelFetch(u_prevGBuffer, q, 0);
+        if (int(g.w) != objId || abs(g.z - depth) > 0.05 * depth || dot(octDecode(g.xy), n) < 0.9) continue;
+
+        float w = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+        color += texelFetch(colorTex, q, 0) * w;
+        moment += texelFetch(momentsTex, q, 0).r * w;
+        weightSum += w;
+    }
+    if (weightSum < 1e-3) return false;
+
+    color /= weightSum;
+    moment /= weightSum;
+    color.a = min(color.a, u_maxHistory);
+    return true;
+}
@@ -0,0 +1,78 @@
+// Случайные числа путей (Sampler.h - то же самое на CPU, бит в бит).
+// SAMPLER_LCG - линейный конгруэнтный генератор, засевается от пикселя и u_seed1.
+// SAMPLER_SOBOL - Sobol со скремблированием Оуэна на хэшах (Burley 2020, "Practical Hash-based Owen Scrambling"):
+// каждый вызов rand() - следующее измерение, измерения идут четвёрками. Внутри четвёрки 4D Sobol
+// по номеру сэмпла u_sampleIndex с перемешанным индексом, ключ скремблирования свой у пикселя и у четвёрки
+
+uniform int u_sampleIndex; // Номер сэмпла с начала накопления
+uniform int u_samplerSeed; // Новый при каждом сбросе накопления, чтобы после сброса не повторять ту же картинку шума
+
+const int SAMPLER_LCG = 0;
+const int SAMPLER_SOBOL = 1;
+
+uint seed;       // LCG: состояние генератора. Sobol: номер следующего измерения
+uint samplerKey; // Sobol: ключ скремблирования пикселя
+
+// Направляющие числа первых четырёх измерений Sobol (Joe-Kuo), по 32 бита на измерение
+const uint SOBOL_DIRECTIONS[128] = uint[128](
+    0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u, 0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u, 0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u, 0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+    0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u, 0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u, 0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u, 0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+    0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u, 0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u, 0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u, 0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+    0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u, 0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u, 0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u, 0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+);
+
+uint hashU32(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint hashCombine(uint h, uint v) {
+    return h ^ (v + (h << 6) + (h >> 2));
+}
+
+uint sobolSample(uint index, uint dim) {
+    uint v = 0u;
+    for (uint bit = 0u; index != 0u; bit++, index >>= 1) {
+        if ((index & 1u) != 0u) v ^= SOBOL_DIRECTIONS[dim * 32u + bit];
+    }
+    return v;
+}
+
+// Перестановка Лайне-Карраса: младшие биты влияют только на старшие, поэтому после разворота битов
+// получается вложенное равномерное скремблирование (Оуэн) - стратификация Sobol сохраняется
+uint nestedUniformScramble(uint x, uint key) {
+    x = bitfieldReverse(x);
+    x += key;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return bitfieldReverse(x);
+}
+
+float sobolOwen(uint index, uint dim) {
+    uint key = hashCombine(samplerKey, hashU32(dim >> 2));
+    uint shuffled = nestedUniformScramble(index, key);
+    uint v = nestedUniformScramble(sobolSample(shuffled, dim & 3u), hashU32(hashCombine(key, dim & 3u)));
+    return float(v >> 8) / float(0x01000000u);
+}
+
+float rand() {
+    if (u_samplerType == SAMPLER_SOBOL) return sobolOwen(uint(u_sampleIndex), seed++);
+    seed = seed * 1664525u + 1013904223u;
+    return float(seed & 0x00FFFFFFu) / float(0x01000000u);
+}
+
+uint samplerPixelKey(uvec2 pixel) {
+    return hashU32(hashCombine(hashU32(uint(u_samplerSeed)), pixel.x | (pixel.y << 16)));
+}
+
+// Начало пути пикселя. lcgSeed - u_seed1.x, общий для всех пикселей сэмпла
+void initSampler(uvec2 pixel, float lcgSeed) {
+    samplerKey = samplerPixelKey(pixel);
+    seed = (u_samplerType == SAMPLER_SOBOL) ? 0u : pixel.x * 1973u + pixel.y * 9277u + uint(lcgSeed * 1000.0) * 26699u;
+}
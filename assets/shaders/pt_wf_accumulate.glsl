@@ -0,0 +1,58 @@
+#version 460 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "pt_wf_common.glsl"
+#include "pt_adaptive.glsl"
+#include "pt_reproject.glsl"
+
+layout(rgba32f, binding = 0) uniform writeonly image2D u_output;
+layout(r32f, binding = 1) uniform writeonly image2D u_outputMoments;
+layout(rgba32f, binding = 2) uniform writeonly image2D u_outputGBuffer;
+layout(rgba8, binding = 3) uniform writeonly image2D u_outputAlbedo; // Активные пиксели пишет extend
+uniform sampler2D u_sample;  // Накопленное за прошлые сэмплы
+uniform sampler2D u_moments;
+uniform float u_sample_part;
+
+// Итог пути смешивается с накопленным, как в конце pt_fragment.glsl. Пиксели погасших тайлов копируются
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(u_resolution);
+    if (pixel.x >= size.x || pixel.y >= size.y) return;
+    uint pathIdx = uint(pixel.y * size.x + pixel.x);
+
+    vec4 last = texelFetch(u_sample, pixel, 0);
+    float lastMoment = texelFetch(u_moments, pixel, 0).r;
+    if (!pixelNeedsSample(pixel)) {
+        imageStore(u_output, pixel, last);
+        imageStore(u_outputMoments, pixel, vec4(lastMoment));
+        imageStore(u_outputGBuffer, pixel, texelFetch(u_prevGBuffer, pixel, 0));
+        imageStore(u_outputAlbedo, pixel, texelFetch(u_prevAlbedo, pixel, 0));
+        return;
+    }
+
+    PathState path = paths[pathIdx];
+    vec3 finalColor = vec3(uintBitsToFloat(path.radiance[0]), uintBitsToFloat(path.radiance[1]), uintBitsToFloat(path.radiance[2]));
+
+    if (SELECTION_ENABLED && path.primaryObjId == u_selectedId) {
+        finalColor = mix(finalColor, vec3(1.0, 0.6, 0.0), 0.3);
+        finalColor += vec3(0.1);
+    }
+
+    // G-буфер первичного попадания, как в pt_fragment.glsl
+    bool miss = path.primaryObjId < 0;
+    float t = miss ? 1e10 : distance(u_pos, path.primaryPos);
+    int gbufferId = path.overlayT < t ? GBUFFER_OVERLAY : path.primaryObjId;
+    vec3 normal = miss ? vec3(0, 0, 1) : octDecode(unpackSnorm2x16(path.primaryNormal));
+    imageStore(u_outputGBuffer, pixel, packGBuffer(normal, miss ? -1.0 : t, gbufferId));
+
+    // Как в pt_fragment.glsl: после движения камеры история берётся репроекцией
+    bool reset = u_sample_part >= 1.0;
+    if (reset && u_reproject != 0 && reprojectHistory(u_sample, u_moments, path.primaryPos, normal, gbufferId, last, lastMoment)) {
+        reset = false;
+    }
+    vec4 color;
+    float moment;
+    accumulateSample(last, lastMoment, finalColor, reset, color, moment);
+    imageStore(u_output, pixel, color);
+    imageStore(u_outputMoments, pixel, vec4(moment));
+}
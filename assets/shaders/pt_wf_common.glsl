@@ -0,0 +1,78 @@
+// Состояние путей и очереди волнового трассировщика (WavefrontTracer.h).
+// Ядра: generate -> (extend -> shade -> shadow) на каждый отскок -> accumulate
+
+#include "pt_common.glsl"
+
+uniform int u_inQueue;        // Какая из двух очередей лучей читается на этом отскоке
+uniform int u_bounce;
+uniform int u_shadowCapacity; // Сколько теневых лучей влезает в буфер
+
+struct PathState {
+    vec3 throughput; uint seed; // seed - состояние генератора (pt_sampler.glsl) между ядрами
+    uint radiance[3]; int primaryObjId; // radiance - биты float, теневые лучи складывают их через CAS
+    vec3 overlayColor; float overlayT;  // Гизмо источников на первичном луче
+    vec3 primaryPos; uint primaryNormal; // Первичное попадание для G-буфера, нормаль - packSnorm2x16(octEncode(n))
+};
+
+struct RayItem {
+    vec3 ro; uint pathIdx;
+    vec3 rd; float pad;
+};
+
+// Результат extend, лежит под тем же индексом, что и луч во входной очереди
+struct HitItem {
+    vec3 p; float t;
+    vec3 n; int objId;
+    vec3 albedo; float pad;
+};
+
+struct ShadowItem {
+    vec3 ro; uint pathIdx;
+    vec3 rd; float maxT;
+    vec3 contribution; float pad; // Уже умножен на throughput пути
+};
+
+layout(std430, binding = 12) buffer PathBuffer { PathState paths[]; };
+layout(std430, binding = 13) buffer RayQueueIn { RayItem raysIn[]; };
+layout(std430, binding = 14) buffer RayQueueOut { RayItem raysOut[]; };
+layout(std430, binding = 15) buffer HitBuffer { HitItem hits[]; };
+layout(std430, binding = 16) buffer ShadowQueue { ShadowItem shadowRays[]; };
+
+// По 4 uint на очередь: аргументы glDispatchComputeIndirect (группы, 1, 1) и длина очереди.
+// Очереди 0 и 1 - лучи (чередуются по отскокам), 2 - теневые лучи
+layout(std430, binding = 17) buffer QueueCounters { uint queueCounters[]; };
+
+const uint QUEUE_SHADOW = 2u;
+const uint WF_GROUP_SIZE = 64u;
+
+uint queueLength(uint queue) {
+    return queueCounters[queue * 4u + 3u];
+}
+
+// Запись в очередь через атомарный счётчик - это и есть компактизация: завершённые пути
+// в следующую очередь не попадают, а число групп для indirect-запуска растёт вместе с длиной
+uint queuePush(uint queue) {
+    uint idx = atomicAdd(queueCounters[queue * 4u + 3u], 1u);
+    if (idx % WF_GROUP_SIZE == 0u) atomicAdd(queueCounters[queue * 4u], 1u);
+    return idx;
+}
+
+// Генератор пути продолжает с того места, где остановилось прошлое ядро. pathIdx - номер пикселя
+void resumeSampler(uint pathIdx) {
+    uint width = uint(u_resolution.x);
+    samplerKey = samplerPixelKey(uvec2(pathIdx % width, pathIdx / width));
+    seed = paths[pathIdx].seed;
+}
+
+// Атомарного сложения float в ядре GL нет, поэтому CAS-цикл по битам
+void addRadiance(uint pathIdx, vec3 value) {
+    for (int c = 0; c < 3; c++) {
+        if (value[c] == 0.0) continue;
+        uint old = paths[pathIdx].radiance[c];
+        while (true) {
+            uint prev = atomicCompSwap(paths[pathIdx].radiance[c], old, floatBitsToUint(uintBitsToFloat(old) + value[c]));
+            if (prev == old) break;
+            old = prev;
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#version 460 core
+layout(local_size_x = 64) in;
+
+#include "pt_wf_common.glsl"
+#include "pt_reproject.glsl"
+
+layout(rgba8, binding = 3) uniform writeonly image2D u_outputAlbedo; // Гид денойзера, как AlbedoOut в pt_fragment.glsl
+
+// Ближайшее пересечение для каждого луча входной очереди
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= queueLength(uint(u_inQueue))) return;
+    RayItem ray = raysIn[idx];
+
+    Hit hit;
+    hit.t = 1e10;
+    hit.objId = -1;
+    checkScene(ray.ro, ray.rd, hit);
+
+    HitItem h;
+    h.p = hit.p;
+    h.t = hit.t;
+    h.n = hit.n;
+    h.objId = hit.objId;
+    h.albedo = hit.albedo;
+    h.pad = 0.0;
+    hits[idx] = h;
+
+    // Первичное попадание нужно для выделения и для пика объекта под курсором
+    if (u_bounce == 0) {
+        paths[ray.pathIdx].primaryObjId = hit.objId;
+        paths[ray.pathIdx].primaryPos = hit.p;
+        paths[ray.pathIdx].primaryNormal = hit.t > 1e9 ? 0u : packSnorm2x16(octEncode(hit.n));
+        uint width = uint(u_resolution.x);
+        ivec2 pixel = ivec2(ray.pathIdx % width, ray.pathIdx / width);
+        if (pixel == ivec2(u_mousePos)) {
+            hoverId = hit.objId;
+        }
+
+        bool overlay = paths[ray.pathIdx].overlayT < hit.t;
+        vec3 albedo = overlay ? paths[ray.pathIdx].overlayColor : (hit.t > 1e9 ? vec3(1) : hit.albedo);
+        imageStore(u_outputAlbedo, pixel, vec4(albedo, 1.0));
+    }
+}
@@ -0,0 +1,45 @@
+#version 460 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "pt_wf_common.glsl"
+#include "pt_adaptive.glsl"
+
+uniform vec2 u_seed1;
+
+// Первичные лучи: по пути на пиксель, которому нужен сэмпл (pt_adaptive.glsl), все сразу в очередь 0
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(u_resolution);
+    if (pixel.x >= size.x || pixel.y >= size.y) return;
+    uint pathIdx = uint(pixel.y * size.x + pixel.x);
+
+    // Погасшие тайлы в очередь не попадают - дальше все ядра идут только по оставшимся путям
+    if (!pixelNeedsSample(pixel)) return;
+
+    initSampler(uvec2(pixel), u_seed1.x);
+    vec2 jitter = (RAY_TRACING == 1) ? (vec2(rand(), rand()) - 0.5) : vec2(0.0);
+    vec2 texCoords = (vec2(pixel) + 0.5) / u_resolution;
+    vec2 uv = ((texCoords + jitter / u_resolution) * 2.0 - 1.0) * vec2(u_resolution.x / u_resolution.y, 1.0);
+    vec3 rd = normalize(mat3(inverse(u_view)) * vec3(uv, -1.5));
+
+    OverlayHit ohit;
+    ohit.t = 1e10;
+    ohit.color = vec3(0);
+    checkOverlays(u_pos, rd, ohit);
+
+    PathState path;
+    path.throughput = vec3(1);
+    path.seed = seed;
+    path.radiance = uint[3](0u, 0u, 0u);
+    path.primaryObjId = -1;
+    path.primaryPos = vec3(0);
+    path.primaryNormal = 0u;
+    path.overlayColor = ohit.color;
+    path.overlayT = ohit.t;
+    paths[pathIdx] = path;
+
+    uint idx = queuePush(0u);
+    raysOut[idx].ro = u_pos;
+    raysOut[idx].pathIdx = pathIdx;
+    raysOut[idx].rd = rd;
+}
@@ -0,0 +1,62 @@
+// Резервуары ReSTIR DI для первичных попаданий волнового трассировщика.
+// На пиксель один резервуар: выбранная точка на источнике, сумма весов RIS, сколько кандидатов за ним стоит (M)
+// и вес W = wSum / (M * p^(y)). Точка хранится как направление от центра источника, поэтому
+// переживает движение источников между кадрами. Цепочка: restir_temporal -> restir_spatial -> shade (отскок 0)
+
+#include "pt_wf_common.glsl"
+
+struct Reservoir {
+    vec3 lightDir; int lightIdx; // Точка на источнике: position + lightDir * radius
+    float wSum; float M; float W; float pad;
+    vec3 surfP; float pad2;      // Поверхность пикселя, для проверки соседей и истории
+    vec3 surfN; float valid;     // valid = 0 - луч ушёл в небо или попал в гизмо
+};
+
+// 19 - после временного переиспользования, 20 - итог (его же читает следующий сэмпл как историю)
+layout(std430, binding = 19) buffer ReservoirTemporal { Reservoir temporalReservoirs[]; };
+layout(std430, binding = 20) buffer ReservoirFinal { Reservoir finalReservoirs[]; };
+
+Reservoir emptyReservoir(vec3 p, vec3 n, bool valid) {
+    Reservoir r;
+    r.lightDir = vec3(0, 1, 0);
+    r.lightIdx = -1;
+    r.wSum = 0.0; r.M = 0.0; r.W = 0.0; r.pad = 0.0;
+    r.surfP = p; r.pad2 = 0.0;
+    r.surfN = n; r.valid = valid ? 1.0 : 0.0;
+    return r;
+}
+
+// Целевая функция p^: яркость вклада без видимости и без альбедо (альбедо общее для всех выборок пикселя)
+float restirTarget(int lightIdx, vec3 lightDir, vec3 p, vec3 n) {
+    if (lightIdx < 0 || lightIdx >= lights.length()) return 0.0;
+    vec3 lightPoint = lights[lightIdx].position + lightDir * lights[lightIdx].radius;
+    return dot(lightContribution(lightIdx, lightPoint, p, n, vec3(1)), vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Потоковый выбор: кандидат заменяет текущий с вероятностью w / wSum
+void reservoirUpdate(inout Reservoir r, int lightIdx, vec3 lightDir, float w, float M) {
+    r.wSum += w;
+    r.M += M;
+    if (w > 0.0 && rand() * r.wSum < w) {
+        r.lightIdx = lightIdx;
+        r.lightDir = lightDir;
+    }
+}
+
+// Слияние чужого резервуара: его выборка перевзвешивается целевой функцией в нашей точке
+void reservoirMerge(inout Reservoir r, Reservoir other, vec3 p, vec3 n) {
+    float target = restirTarget(other.lightIdx, other.lightDir, p, n);
+    reservoirUpdate(r, other.lightIdx, other.lightDir, target * other.W * other.M, other.M);
+}
+
+void reservoirFinalize(inout Reservoir r, vec3 p, vec3 n) {
+    float target = restirTarget(r.lightIdx, r.lightDir, p, n);
+    r.W = (target > 0.0 && r.M > 0.0) ? r.wSum / (r.M * target) : 0.0;
+}
+
+// Соседняя поверхность похожа на нашу настолько, что её выборку можно переиспользовать
+bool similarSurface(Reservoir other, vec3 p, vec3 n) {
+    if (other.valid == 0.0) return false;
+    float depth = max(length(p - u_pos), 1e-3);
+    return dot(other.surfN, n) > 0.9 && abs(dot(other.surfP - p, n)) < 0.05 * depth;
+}
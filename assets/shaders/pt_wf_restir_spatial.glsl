@@ -0,0 +1,42 @@
+#version 460 core
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#include "pt_wf_restir.glsl"
+#include "pt_adaptive.glsl"
+
+uniform int u_neighbors;  // Сколько соседей сливается с резервуаром пикселя
+uniform float u_radius;   // Радиус поиска соседей в пикселях
+
+// Пространственное переиспользование: выборки случайных соседей перевзвешиваются в точке пикселя
+void main() {
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = ivec2(u_resolution);
+    if (pixel.x >= size.x || pixel.y >= size.y) return;
+    uint pathIdx = uint(pixel.y * size.x + pixel.x);
+    // Погасший тайл: временный проход его не трогал, в резервуаре прошлый сэмпл, а пути нет вовсе
+    if (!pixelNeedsSample(pixel)) return;
+
+    Reservoir self = temporalReservoirs[pathIdx];
+    if (self.valid == 0.0) {
+        finalReservoirs[pathIdx] = self;
+        return;
+    }
+    resumeSampler(pathIdx);
+
+    vec3 p = self.surfP, n = self.surfN;
+    Reservoir r = emptyReservoir(p, n, true);
+    reservoirMerge(r, self, p, n);
+    for (int k = 0; k < u_neighbors; k++) {
+        float angle = 2.0 * PI * rand();
+        vec2 offset = vec2(cos(angle), sin(angle)) * u_radius * sqrt(rand());
+        ivec2 q = clamp(pixel + ivec2(round(offset)), ivec2(0), size - 1);
+        if (q == pixel) continue;
+        Reservoir other = temporalReservoirs[q.y * size.x + q.x];
+        if (!similarSurface(other, p, n)) continue;
+        reservoirMerge(r, other, p, n);
+    }
+    reservoirFinalize(r, p, n);
+
+    finalReservoirs[pathIdx] = r;
+    paths[pathIdx].seed = seed;
+}
@@ -0,0 +1,52 @@
+#version 460 core
+layout(local_size_x = 64) in;
+
+#include "pt_wf_restir.glsl"
+#include "pt_reproject.glsl"
+
+uniform int u_hasHistory;  // 0 - истории нет (первый сэмпл, смена разрешения)
+uniform int u_candidates;  // Сколько кандидатов RIS на пиксель
+
+// Первичные попадания: кандидаты из дерева источников (RIS), затем слияние с историей этого же места
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= queueLength(uint(u_inQueue))) return;
+    HitItem hit = hits[idx];
+    uint pathIdx = raysIn[idx].pathIdx;
+
+    if (hit.t > 1e9 || paths[pathIdx].overlayT < hit.t || lights.length() == 0) {
+        temporalReservoirs[pathIdx] = emptyReservoir(hit.p, hit.n, false);
+        return;
+    }
+    resumeSampler(pathIdx);
+
+    Reservoir r = emptyReservoir(hit.p, hit.n, true);
+    for (int c = 0; c < u_candidates; c++) {
+        float pdf;
+        int i = sampleLightTree(hit.p, hit.n, pdf);
+        if (i < 0) {
+            r.M += 1.0;
+            continue;
+        }
+        vec3 dir = randomOnSphere();
+        reservoirUpdate(r, i, dir, restirTarget(i, dir, hit.p, hit.n) / pdf, 1.0);
+    }
+
+    if (u_hasHistory != 0) {
+        // u_prevView здесь - камера прошлого сэмпла
+        ivec2 prevPixel = ivec2(floor(prevPixelCoord(hit.p)));
+        ivec2 size = ivec2(u_resolution);
+        if (all(greaterThanEqual(prevPixel, ivec2(0))) && all(lessThan(prevPixel, size))) {
+            Reservoir prev = finalReservoirs[prevPixel.y * size.x + prevPixel.x];
+            if (similarSurface(prev, hit.p, hit.n)) {
+                // Ограничение истории: иначе старая выборка не уступает место новым и освещение "залипает"
+                prev.M = min(prev.M, 20.0 * float(u_candidates));
+                reservoirMerge(r, prev, hit.p, hit.n);
+            }
+        }
+    }
+    reservoirFinalize(r, hit.p, hit.n);
+
+    temporalReservoirs[pathIdx] = r;
+    paths[pathIdx].seed = seed;
+}
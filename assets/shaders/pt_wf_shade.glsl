@@ -0,0 +1,87 @@
+#version 460 core
+layout(local_size_x = 64) in;
+
+#include "pt_wf_restir.glsl"
+
+uniform int u_restir; // 1 - первичные попадания освещаются выборкой из резервуара ReSTIR
+
+// Материал в точке попадания: теневые лучи на источники и продолжение пути в следующую очередь
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= queueLength(uint(u_inQueue))) return;
+    RayItem ray = raysIn[idx];
+    HitItem hit = hits[idx];
+    uint pathIdx = ray.pathIdx;
+    vec3 throughput = paths[pathIdx].throughput;
+    resumeSampler(pathIdx);
+
+    // Гизмо перекрывает первичное попадание целиком
+    if (u_bounce == 0 && paths[pathIdx].overlayT < hit.t) {
+        addRadiance(pathIdx, paths[pathIdx].overlayColor);
+        return;
+    }
+
+    if (RAY_TRACING == 0) {
+        addRadiance(pathIdx, hit.t > 1e9 ? skyColor(ray.rd) * 0.5 : previewShading(hit.albedo, hit.n));
+        return;
+    }
+
+    if (hit.t > 1e9) {
+        addRadiance(pathIdx, throughput * skyColor(ray.rd) * 0.2);
+        return;
+    }
+
+    vec3 from = hit.p + hit.n * 0.001;
+    // Направление отскока раньше прямого света, как в pt_fragment.glsl
+    vec3 nextDir = randomCosineHemisphere(hit.n);
+    bool useReservoir = u_restir != 0 && u_bounce == 0;
+    int count = useReservoir ? 1 : lightSampleCount();
+    for (int s = 0; s < count; s++) {
+        int i;
+        vec3 lightPoint;
+        vec3 contribution;
+        if (useReservoir) {
+            // Один теневой луч на пиксель: выборка уже отобрана из всех кандидатов, соседей и истории
+            Reservoir r = finalReservoirs[pathIdx];
+            i = r.lightIdx;
+            if (i < 0 || i >= lights.length() || r.W <= 0.0) continue;
+            lightPoint = lights[i].position + r.lightDir * lights[i].radius;
+            contribution = lightContribution(i, lightPoint, hit.p, hit.n, hit.albedo) * r.W;
+        } else {
+            float weight;
+            i = pickLight(s, hit.p, hit.n, weight);
+            if (i < 0) continue;
+            contribution = sampleLight(i, hit.p, hit.n, hit.albedo, lightPoint) * weight;
+        }
+        if (contribution == vec3(0)) continue;
+
+        uint slot = queuePush(QUEUE_SHADOW);
+        if (slot >= uint(u_shadowCapacity)) continue;
+        vec3 dir = lightPoint - from;
+        shadowRays[slot].ro = from;
+        shadowRays[slot].pathIdx = pathIdx;
+        shadowRays[slot].rd = normalize(dir);
+        shadowRays[slot].maxT = length(dir) - 0.002;
+        shadowRays[slot].contribution = throughput * contribution;
+    }
+
+    if (u_bounce + 1 < MAX_BOUNCES) {
+        throughput *= hit.albedo;
+
+        bool alive = true;
+        if (u_bounce > 2) {
+            float p = max(throughput.r, max(throughput.g, throughput.b));
+            if (rand() > p) alive = false;
+            else throughput /= p;
+        }
+
+        if (alive) {
+            uint o = queuePush(uint(1 - u_inQueue));
+            raysOut[o].ro = from;
+            raysOut[o].pathIdx = pathIdx;
+            raysOut[o].rd = nextDir;
+        }
+        paths[pathIdx].throughput = throughput;
+    }
+    paths[pathIdx].seed = seed;
+}
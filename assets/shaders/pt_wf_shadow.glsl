@@ -0,0 +1,13 @@
+#version 460 core
+layout(local_size_x = 64) in;
+
+#include "pt_wf_common.glsl"
+
+// Видимость источника (any-hit, см. isOccluded): незаслонённый вклад добавляется к пути
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= min(queueLength(QUEUE_SHADOW), uint(u_shadowCapacity))) return;
+    ShadowItem s = shadowRays[idx];
+
+    if (!isOccluded(s.ro, s.rd, s.maxT)) addRadiance(s.pathIdx, s.contribution);
+}
@@ -2,58 +2,119 @@
 out vec4 FragColor;
 in vec2 TexCoords;
 
+// Кадр уже отфильтрован (Denoiser, denoise_atrous.glsl), здесь растяжение на окно.
+// При рендере ниже разрешения окна - апскейл в духе FSR EASU: 12 выборок вокруг пикселя, ядро Ланцоша,
+// вытянутое вдоль найденного края, и клэмп к соседям против звона. Повышение резкости (как RCAS)
+// делается тут же по тем же выборкам, без отдельного полноэкранного прохода
 uniform sampler2D screenTexture;
 uniform float opacity;
 uniform vec2 u_resolution;
-uniform int u_useDenoise;
+uniform vec2 u_inputSize;   // Кадр занимает левый нижний угол текстуры (динамическое разрешение)
+uniform int u_upscale;      // 0 - обычная билинейка
+uniform float u_sharpness;  // 0 - без повышения резкости
 
-// Настройки денозера
-const float SIGMA = 5.0;      // Радиус размытия
-const float BSIGMA = 0.2;    // Порог сохранения границ (чем меньше, тем резче края)
-const float M_SIZE = 5.0;     // Размер ядра
+ivec2 inputSize;
 
-float normpdf(float x, float s) {
-    return 0.39894 * exp(-0.5 * x * x / (s * s)) / s;
+vec3 tap(ivec2 p) {
+    return texelFetch(screenTexture, clamp(p, ivec2(0), inputSize - 1), 0).rgb;
+}
+
+float luma(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Направление и «чистота» края по кресту вокруг одного из четырёх центральных текселей.
+// len близко к 1, если перепад ровный (край или градиент), к 0 - если это одиночный выброс
+void edgeAt(float w, float lL, float lC, float lR, float lU, float lD, inout vec2 dir, inout float len) {
+    float dx = lR - lL;
+    float lenX = clamp(abs(dx) / max(max(abs(lR - lC), abs(lC - lL)), 1e-5), 0.0, 1.0);
+    float dy = lD - lU;
+    float lenY = clamp(abs(dy) / max(max(abs(lD - lC), abs(lC - lU)), 1e-5), 0.0, 1.0);
+    dir += w * vec2(dx, dy);
+    len += w * (lenX * lenX + lenY * lenY);
+}
+
+// Ланцош-2 через полиномы, как в EASU: base - окно, lob задаёт глубину отрицательного лепестка
+void accumulateTap(vec2 offset, vec2 dir, vec2 len2, float lob, float clp, vec3 c, inout vec3 sum, inout float sumW) {
+    vec2 v = vec2(dot(offset, dir), dot(offset, vec2(-dir.y, dir.x))) * len2;
+    float d2 = min(dot(v, v), clp);
+    float base = 25.0 / 16.0 * (2.0 / 5.0 * d2 - 1.0) * (2.0 / 5.0 * d2 - 1.0) - (25.0 / 16.0 - 1.0);
+    float window = (lob * d2 - 1.0) * (lob * d2 - 1.0);
+    float w = base * window;
+    sum += w * c;
+    sumW += w;
+}
+
+vec3 upscale(vec2 uv) {
+    vec2 pp = uv * vec2(inputSize) - 0.5;
+    ivec2 fp = ivec2(floor(pp));
+    vec2 f = pp - vec2(fp);
+
+    //    b c
+    //  e f g h
+    //  i j k l
+    //    n o
+    vec3 b = tap(fp + ivec2(0, -1)), c = tap(fp + ivec2(1, -1));
+    vec3 e = tap(fp + ivec2(-1, 0)), fC = tap(fp), g = tap(fp + ivec2(1, 0)), h = tap(fp + ivec2(2, 0));
+    vec3 i = tap(fp + ivec2(-1, 1)), j = tap(fp + ivec2(0, 1)), k = tap(fp + ivec2(1, 1)), l = tap(fp + ivec2(2, 1));
+    vec3 n = tap(fp + ivec2(0, 2)), o = tap(fp + ivec2(1, 2));
+
+    float lb = luma(b), lc = luma(c), le = luma(e), lf = luma(fC), lg = luma(g), lh = luma(h);
+    float li = luma(i), lj = luma(j), lk = luma(k), ll = luma(l), ln = luma(n), lo = luma(o);
+
+    // Край ищем по центральному квадрату f g j k с билинейными весами
+    vec2 dir = vec2(0.0);
+    float len = 0.0;
+    edgeAt((1.0 - f.x) * (1.0 - f.y), le, lf, lg, lb, lj, dir, len);
+    edgeAt(f.x * (1.0 - f.y), lf, lg, lh, lc, lk, dir, len);
+    edgeAt((1.0 - f.x) * f.y, li, lj, lk, lf, ln, dir, len);
+    edgeAt(f.x * f.y, lj, lk, ll, lg, lo, dir, len);
+
+    float dirLen2 = dot(dir, dir);
+    dir = dirLen2 < 1.0 / 32768.0 ? vec2(1.0, 0.0) : dir * inversesqrt(dirLen2);
+    len = len * 0.5;
+    len *= len;
+
+    // Вдоль края ядро растягивается, поперёк сжимается; на чистом крае лепесток глубже
+    float stretch = 1.0 / max(abs(dir.x), abs(dir.y));
+    vec2 len2 = vec2(1.0 + (stretch - 1.0) * len, 1.0 - 0.5 * len);
+    float lob = 0.5 + ((1.0 / 4.0 - 0.04) - 0.5) * len;
+    float clp = 1.0 / lob;
+
+    vec3 sum = vec3(0.0);
+    float sumW = 0.0;
+    accumulateTap(vec2(0.0, -1.0) - f, dir, len2, lob, clp, b, sum, sumW);
+    accumulateTap(vec2(1.0, -1.0) - f, dir, len2, lob, clp, c, sum, sumW);
+    accumulateTap(vec2(-1.0, 0.0) - f, dir, len2, lob, clp, e, sum, sumW);
+    accumulateTap(vec2(0.0, 0.0) - f, dir, len2, lob, clp, fC, sum, sumW);
+    accumulateTap(vec2(1.0, 0.0) - f, dir, len2, lob, clp, g, sum, sumW);
+    accumulateTap(vec2(2.0, 0.0) - f, dir, len2, lob, clp, h, sum, sumW);
+    accumulateTap(vec2(-1.0, 1.0) - f, dir, len2, lob, clp, i, sum, sumW);
+    accumulateTap(vec2(0.0, 1.0) - f, dir, len2, lob, clp, j, sum, sumW);
+    accumulateTap(vec2(1.0, 1.0) - f, dir, len2, lob, clp, k, sum, sumW);
+    accumulateTap(vec2(2.0, 1.0) - f, dir, len2, lob, clp, l, sum, sumW);
+    accumulateTap(vec2(0.0, 2.0) - f, dir, len2, lob, clp, n, sum, sumW);
+    accumulateTap(vec2(1.0, 2.0) - f, dir, len2, lob, clp, o, sum, sumW);
+
+    vec3 color = sum / sumW;
+
+    // Резкость вместо отдельного RCAS: отличие от билинейки усиливается и снова зажимается
+    // в диапазон центрального квадрата, так что ореолов на краях нет
+    vec3 bilinear = mix(mix(fC, g, f.x), mix(j, k, f.x), f.y);
+    vec3 mn = min(min(fC, g), min(j, k));
+    vec3 mx = max(max(fC, g), max(j, k));
+    color += u_sharpness * (color - bilinear);
+    return clamp(color, mn, mx);
 }
 
 void main() {
-    vec3 centerColor = texture(screenTexture, TexCoords).rgb;
-    
-    if (u_useDenoise == 0) {
-        FragColor = vec4(centerColor, opacity);
+    inputSize = ivec2(u_inputSize);
+    if (u_upscale == 0) {
+        // Половину текселя от края под-прямоугольника не берём, иначе билинейка зацепит мусор за ним
+        vec2 texSize = vec2(textureSize(screenTexture, 0));
+        vec2 uv = clamp(TexCoords * u_inputSize, vec2(0.5), u_inputSize - 0.5) / texSize;
+        FragColor = vec4(texture(screenTexture, uv).rgb, opacity);
         return;
     }
-    
-    vec3 final_colour = vec3(0.0);
-    float Z = 0.0;
-    
-    float kernel[11];
-    for (int j = 0; j <= int(M_SIZE); ++j) {
-        kernel[int(M_SIZE) + j] = kernel[int(M_SIZE) - j] = normpdf(float(j), SIGMA);
-    }
-    
-    float bsigma2 = BSIGMA * BSIGMA;
-    vec2 invRes = 1.0 / u_resolution;
-
-    // Проход по соседним пикселям
-    for (int i = -int(M_SIZE); i <= int(M_SIZE); ++i) {
-        for (int j = -int(M_SIZE); j <= int(M_SIZE); ++j) {
-            vec2 offset = vec2(float(i), float(j)) * invRes;
-            vec3 sampleColor = texture(screenTexture, TexCoords + offset).rgb;
-            
-            // Математика биллятерального фильтра
-            float factor = kernel[int(M_SIZE) + j] * kernel[int(M_SIZE) + i];
-            vec3 diff = sampleColor - centerColor;
-            float dist2 = dot(diff, diff);
-            float bWeight = exp(-(dist2) / (2.0 * bsigma2));
-            
-            float weight = factor * bWeight;
-            Z += weight;
-            final_colour += weight * sampleColor;
-        }
-    }
-
-    vec3 denoised = final_colour / Z;
-    
-    FragColor = vec4(denoised, opacity);
-}
\ No newline at end of file
+    FragColor = vec4(upscale(TexCoords), opacity);
+}
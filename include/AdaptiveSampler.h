@@ -0,0 +1,66 @@
+#ifndef ADAPTIVE_SAMPLER_H
+#define ADAPTIVE_SAMPLER_H
+
+#include <glad/gl.h>
+#include "Shader.h"
+
+// Адаптивная выборка по шуму пикселей. Накопленный цвет хранит в альфе число сэмплов пикселя,
+// рядом лежит среднее квадрата яркости (Framebuffer::textureMoments). Перед сэмплом pt_adaptive_mask.glsl
+// по ним строит маску тайлов 8x8 (SSBO binding 21): тайл гаснет, когда стандартная ошибка среднего
+// у всех его пикселей ниже порога. Фрагментный проход копирует погасшие тайлы, волновой их не генерирует.
+// Маска строится только по истории текущей камеры, то есть со второго сэмпла после сброса накопления:
+// при одном сэмпле на кадр и движущейся камере она не включается. minSamples проверяется попиксельно
+// по числу сэмплов в альфе, так что перенесённая репроекцией история тоже засчитывается
+class AdaptiveSampler {
+public:
+    bool enabled = true;
+    int minSamples = 16;     // До этого шум не оценивается, сэмплы получают все
+    float threshold = 0.02f; // Относительная ошибка среднего
+
+    AdaptiveSampler();
+    ~AdaptiveSampler();
+
+    AdaptiveSampler(const AdaptiveSampler&) = delete;
+    AdaptiveSampler& operator=(const AdaptiveSampler&) = delete;
+
+    // Перед сэмплом: строит маску по накопленному и привязывает её. historyValid - в накопленном
+    // уже есть сэмплы с текущей камерой (не первый сэмпл после сброса). false - маска не действует
+    // (выключено или истории нет), тогда шейдерам u_adaptive = 0
+    bool prepareSample(int width, int height, bool historyValid, GLuint colorTexture, GLuint momentsTexture);
+
+    // Накопленное выброшено целиком (ресайз, сцена, LOD, сброс без репроекции): счётчики в полёте
+    // описывают другую картинку. Репроекция и сдвиг источников историю сохраняют - для них не вызывать
+    void invalidate();
+
+    // Раз в кадр после сэмплов: копирует счётчик последней маски в кольцо чтения и забирает
+    // самый свежий готовый. Конвейер не ждёт, число отстаёт на пару кадров
+    void readStats();
+
+    // activeTiles - по маске нескольких кадров назад, но той же истории: после invalidate()
+    // считается, что активны все тайлы, пока не дойдёт новая маска. Годится только чтобы
+    // перестать тратить бюджет кадра, сами сэмплы отсекает маска на GPU
+    int activeTiles = 0;
+    int totalTiles = 0;
+    bool converged() const { return maskValid && statsValid && activeTiles == 0; }
+
+    bool pollReload() { return maskShader.pollReload(); }
+
+private:
+    Shader maskShader;
+    GLuint maskBuffer = 0;
+    int maskCapacity = 0;
+    bool maskValid = false; // Последний prepareSample построил маску
+
+    // Кольцо чтения счётчика: постоянно отображённый буфер и забор по забору на слот
+    static const int kReadbackSlots = 3;
+    void createReadback();
+    GLuint readbackBuffer = 0;
+    const GLuint* readbackPtr = nullptr;
+    GLsync readbackFences[kReadbackSlots] = {};
+    unsigned readbackEpochs[kReadbackSlots] = {};
+    int readbackSlot = 0;      // Следующий слот для записи, он же самый старый
+    unsigned epoch = 0;        // Меняется в invalidate() и при смене числа тайлов, старые счётчики отбрасываются
+    bool statsValid = false;   // activeTiles пришёл из маски текущей истории
+};
+
+#endif
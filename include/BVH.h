@@ -15,8 +15,12 @@ struct GPUMeshObject {
     int pad3; int pad4; int pad5;
 };
 
+// Предел глубины дерева: обход в шейдере хранит пройденные уровни битами в uint (restart trail),
+// поэтому узлы глубже 31 не делятся и остаются листьями
+const int MAX_BVH_DEPTH = 31;
+
 extern std::vector<GPUBVHNode> allBVHNodes;
 extern std::vector<GPUMeshObject> allObjects;
 
 void UpdateNodeBounds(int nodeIdx, std::vector<GPUBVHNode>& nodes, const std::vector<GPUMeshTriangle>& tris);
-void Subdivide(int nodeIdx, std::vector<GPUBVHNode>& nodes, std::vector<GPUMeshTriangle>& tris);
\ No newline at end of file
+void Subdivide(int nodeIdx, std::vector<GPUBVHNode>& nodes, std::vector<GPUMeshTriangle>& tris, int depth = 0);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include <glad/gl.h>
+#include "Shader.h"
+#include "Framebuffer.h"
+
+// Денойзер а-труа в духе SVGF (denoise_atrous.glsl). Гиды берёт из фреймбуфера трассировщика:
+// нормаль, глубина и objId из textureGBuffer, альбедо из textureAlbedo, дисперсия из textureMoments.
+// Один проход оценки дисперсии и passes проходов 5x5 с удваивающимся шагом - 25 выборок на проход
+// вместо 121 у старого билатерального фильтра в screen_f.glsl
+class Denoiser {
+public:
+    bool enabled = true;
+    int passes = 5;            // Шаги 1, 2, 4, 8, 16 - охват 125x125 (±2 * 31 пикселей)
+    float sigmaColor = 4.0f;
+    float sigmaNormal = 128.0f;
+    float sigmaDepth = 1.0f;
+    float sigmaAlbedo = 0.25f;
+
+    Denoiser();
+    ~Denoiser();
+
+    Denoiser(const Denoiser&) = delete;
+    Denoiser& operator=(const Denoiser&) = delete;
+
+    // Фильтрует левый нижний угол width x height накопленного кадра fb,
+    // возвращает текстуру результата (RGBA32F размером с fb, занят тот же угол)
+    GLuint apply(const Framebuffer& fb, int width, int height);
+
+    bool pollReload() { return atrousShader.pollReload(); }
+
+private:
+    Shader atrousShader;
+    GLuint pingPong[2] = { 0, 0 }; // rgb - освещённость, a - дисперсия
+    int texWidth = 0, texHeight = 0;
+
+    void resize(int w, int h);
+};
+
+#endif
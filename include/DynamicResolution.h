@@ -0,0 +1,25 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+// Динамическое разрешение: рендер идёт в под-прямоугольник фреймбуфера фиксированного размера,
+// доля scale подбирается по GPU-цене сэмпла (её меряет SampleScheduler) так, чтобы хотя бы один
+// сэмпл влезал в кадр targetFPS. Гистерезис: вниз - после пары кадров перебора, вверх - только после долгого запаса
+class DynamicResolution {
+public:
+    bool enabled = false;
+    float minScale = 0.5f;        // Нижняя граница доли по каждой оси
+    float budgetFraction = 0.8f;  // Остальное кадра - денойзер, экранный проход и ImGui
+    float scale = 1.0f;           // Текущая доля от целевого разрешения
+
+    float gpuSampleMs = 0.0f;     // Цена сэмпла при текущей доле
+
+    // Раз в кадр до рендера. sampleSeconds - цена сэмпла при текущей доле, < 0 - нового замера нет.
+    // true - разрешение поменялось
+    bool update(float frameBudget, float sampleSeconds);
+
+private:
+    int overFrames = 0;
+    int underFrames = 0;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+
+enum VSyncMode { VSYNC_OFF, VSYNC_ON, VSYNC_ADAPTIVE };
+
+// Ограничитель кадров вместо пустого цикла ожидания. Кадры идут по сетке дедлайнов с шагом 1/targetFPS
+// (без накопления дрейфа). До дедлайна спим грубо (sleep_for), последние spinMs - короткое ожидание
+// с yield, где точности сна уже не хватает. Порог подстраивается под то, насколько ОС пересыпает.
+// В режиме lowLatency ожидание переносится в начало кадра: ввод опрашивается как можно позже,
+// за прогнозируемое время работы кадра до дедлайна
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    bool lowLatency = false;
+    int vsync = VSYNC_OFF;  // VSyncMode, применяется в beginFrame
+
+    // Статистика по последним kHistory кадрам
+    float intervalMs = 0.0f;     // Средний интервал между кадрами
+    float jitterMs = 0.0f;       // Стандартное отклонение интервала
+    float maxDeviationMs = 0.0f; // Худшее отклонение от целевого интервала
+    float idlePercent = 0.0f;    // Доля ожидания, которую CPU проспал, а не прокрутил
+    bool adaptiveSupported = false;
+
+    FramePacer();
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    // Перед опросом ввода. В lowLatency ждёт здесь
+    void beginFrame(int targetFPS);
+    // Сразу после SwapBuffers. В обычном режиме ждёт здесь
+    void endFrame();
+
+private:
+    static const int kHistory = 120;
+
+    void waitUntil(Clock::time_point deadline);
+    void applyVSync();
+
+    Clock::duration period{};
+    Clock::time_point nextDeadline{};
+    Clock::time_point workStart{};
+    Clock::time_point lastPresent{};
+    bool started = false;
+    int appliedVSync = -1;
+
+    double workMs = 0.0, workDevMs = 0.0;  // Сглаженное время работы кадра и его разброс
+    double spinThresholdMs = 2.0;          // Сколько до дедлайна не доверяем sleep_for
+    double sleptMs = 0.0, spunMs = 0.0;
+
+    float intervals[kHistory] = {};
+    int intervalCount = 0;
+};
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Параметры кадра для pt_fragment.glsl, блок FrameUniforms (std140, binding = 0).
+// Заливается одним glBufferSubData на кадр, внутри цикла накопления остаются только u_sample_part и u_seed1
+struct FrameUniforms {
+    glm::mat4 view;
+    glm::vec3 camPos; float floorSize;
+    glm::vec2 resolution;
+    glm::vec2 mousePos;
+    int useRayTracing;
+    int showLightGizmos;
+    int selectedId;
+    int geometryFormat;
+    int maxBounces;
+    int lightSamples; // 0 - по теневому лучу на каждый источник, иначе выборки из дерева источников
+    int samplerType;  // SamplerType из Sampler.h
+    int pad;
+};
+
+static_assert(sizeof(FrameUniforms) == 128, "FrameUniforms must match the std140 layout in pt_fragment.glsl");
+
+const unsigned int FRAME_UBO_BINDING = 0;
@@ -6,7 +6,10 @@
 class Framebuffer {
 public:
     unsigned int fbo;         // ID фреймбуфера
-    unsigned int textureColor; // Текстура, куда рисуется кадр
+    unsigned int textureColor; // Текстура, куда рисуется кадр (в альфе - число накопленных сэмплов пикселя)
+    unsigned int textureMoments; // Среднее квадрата яркости, для оценки шума в AdaptiveSampler
+    unsigned int textureGBuffer; // Первичное попадание: нормаль (октаэдр), расстояние, objId - для репроекции (pt_reproject.glsl)
+    unsigned int textureAlbedo;  // Альбедо первичного попадания, гид для Denoiser
     int width, height;
 
     Framebuffer(int width, int height);
@@ -1,9 +1,52 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cstdint>
+
+// Формат треугольников, которые уходят в шейдер (u_geometryFormat / PERM_GEOMETRY_FORMAT)
+enum GeometryFormat { GEOMETRY_FULL = 0, GEOMETRY_QUANTIZED = 1, GEOMETRY_INDEXED = 2 };
 
 struct GPUMeshTriangle {
     glm::vec3 v0; float pad1;
     glm::vec3 v1; float pad2;
     glm::vec3 v2; float pad3;
-    glm::vec3 color; float pad4;
-};
\ No newline at end of file
+    glm::vec3 color; int32_t attribId; // Индекс в allTriangleAttribs, -1 - нет UV/текстуры
+};
+
+// Компактный треугольник (32 байта вместо 64): вершины в uint16 относительно AABB объекта,
+// распаковываются прямо в шейдере при пересечении
+struct GPUQuantTriangle {
+    uint32_t p0, p1, p2, p3, p4; // v0.xy | v0.z v1.x | v1.yz | v2.xy | v2.z
+    uint32_t color;              // RGBA8
+    int32_t attribId;
+    uint32_t pad;
+};
+
+// Индексированный треугольник (20 байт): вершины общие, лежат в allVertices по 3 float
+struct GPUIndexedTriangle {
+    uint32_t i0, i1, i2;
+    uint32_t color;              // RGBA8
+    int32_t attribId;
+};
+
+// UV вершин треугольника и его материал. Читается один раз на ближайшее попадание
+struct GPUTriangleAttrib {
+    glm::vec2 uv0, uv1, uv2;
+    int32_t materialId;
+    int32_t pad;
+};
+
+// Картинки материалов разложены по корзинам размера, у каждой свой массив текстур с мипами:
+// мелкая картинка не занимает слой размера самой крупной. Корзина b - картинки до MATERIAL_TEX_MIN_BUCKET << b,
+// последняя - все крупнее. Юнит первой корзины - прежний u_materialTex, остальные после u_prevAlbedo
+const int MATERIAL_TEX_BUCKETS = 4;
+const int MATERIAL_TEX_MIN_BUCKET = 256;
+const int MATERIAL_TEX_UNITS[MATERIAL_TEX_BUCKETS] = { 3, 7, 8, 9 };
+
+// Base color текстура материала лежит в слое textureLayer массива корзины textureBucket,
+// занимая прямоугольник uvRect (offset.xy, scale.zw) внутри слоя
+struct GPUMaterial {
+    glm::vec4 uvRect;
+    int32_t textureLayer;  // -1 - без текстуры
+    int32_t textureBucket;
+    glm::vec2 textureSize; // Размер картинки в текселях, для выбора мипа
+};
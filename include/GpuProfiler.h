@@ -0,0 +1,74 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+// Профайлер проходов кадра на GPU. Каждый begin/end ставит пару GL_TIMESTAMP (в отличие от
+// GL_TIME_ELAPSED их можно вкладывать), пулы запросов на kFrames кадров вперёд: результат читается
+// через несколько кадров, когда он уже готов, и CPU никогда не ждёт GPU.
+// История по проходам - для окна с графиками (drawWindow) и выгрузки в CSV
+class GpuProfiler {
+public:
+    static const int kHistory = 240;
+
+    struct Pass {
+        std::string name;
+        float history[kHistory] = {}; // Кольцо, свежий кадр на historyPos - 1
+        float avgMs = 0.0f;           // Сглаженное
+    };
+
+    GpuProfiler();
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // Раз в кадр: забирает готовые кадры и открывает новый (если его пул уже прочитан)
+    void beginFrame();
+    void endFrame();
+
+    // Скобки вокруг прохода, вкладываются. Одинаковые имена за кадр суммируются
+    void begin(const char* name);
+    void end();
+
+    const std::vector<Pass>& passes() const { return passList; }
+    float passMs(const char* name) const; // Сглаженное время прохода, 0 - если его не было
+    float frameMs = 0.0f; // От первой метки кадра до последней, сглаженное
+    float frameHistory[kHistory] = {};
+    int historyPos = 0;   // Сколько кадров прочитано всего
+
+    // Вся накопленная история: кадр, полное время и по столбцу на проход
+    bool exportCSV(const std::string& path) const;
+
+    // Окно ImGui с графиками и кнопкой выгрузки. budgetMs - линия бюджета кадра
+    void drawWindow(bool* open, float budgetMs);
+
+private:
+    static const int kFrames = 4;
+    static const int kMaxScopes = 16;
+
+    struct Scope {
+        GLuint queries[2] = {}; // Начало и конец
+        int pass = -1;
+    };
+    struct FrameSlot {
+        Scope scopes[kMaxScopes];
+        int count = 0;
+        GLuint lastQuery = 0; // Последняя поставленная метка: у вложенных скоупов это конец внешнего, а не scopes[count - 1]
+        bool pending = false;
+    };
+
+    int findPass(const char* name);
+    void collect();
+
+    FrameSlot frames[kFrames];
+    int frameCounter = 0;
+    FrameSlot* active = nullptr;
+    std::vector<int> openScopes;
+    std::vector<Pass> passList;
+    std::string exportStatus;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#include <vector>
+
+// Один уровень мип-цепочки, всегда RGBA8
+struct MipLevel {
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Box-фильтр 2x2 (SSE2, если есть). Размер следующего уровня как у glGenerateMipmap: max(1, n / 2)
+void DownsampleBox(const MipLevel& src, MipLevel& dst);
+
+// Полная цепочка до 1x1, [0] - исходное изображение
+std::vector<MipLevel> BuildMipChain(const unsigned char* rgba, int width, int height);
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glad/gl.h>
 #include <vector>
+#include "Sampler.h"
 
 namespace lightsys {
     struct GPULight {
@@ -12,8 +13,45 @@ namespace lightsys {
     float pad; 
 };
 
+// Узел дерева источников (LightTreeBuffer, binding 18). Дети лежат парой: child и child + 1.
+// В листе ровно один источник: child < 0, индекс источника = ~child
+struct GPULightNode {
+    glm::vec3 minBounds; float power; // Сумма мощностей источников под узлом
+    glm::vec3 maxBounds; int child;
+};
+
 extern GLuint lightSSBO;
+extern GLuint lightTreeSSBO;
 extern std::vector<GPULight> allLights;
+extern std::vector<GPULightNode> lightTree;
 
 void AddLight(glm::vec3 pos, float rad, glm::vec3 power);
-}
\ No newline at end of file
+
+// Дерево по текущим позициям allLights (медианное деление по длинной оси), O(n log n)
+void BuildLightTree();
+
+// Обновляет границы и мощности узлов без смены топологии, O(n) - для источников, которые двигаются каждый кадр
+void RefitLightTree();
+
+// Обновляет дерево (пересборка, если изменилось число источников, иначе refit) и заливает
+// источники (binding 5) и дерево (binding 18). Зовётся после любых изменений allLights
+void UploadLights();
+
+// Важность узла для точки p с нормалью n: мощность * оценка косинуса сверху / квадрат расстояния.
+// Ноль, только если весь узел под горизонтом - тогда его вклад точно нулевой
+float LightNodeImportance(const GPULightNode& node, const glm::vec3& p, const glm::vec3& n);
+
+// Выбор источника спуском по дереву, как sampleLightTree в шейдере: на каждом уровне новое число
+// из sampler (rand() в шейдере). Возвращает индекс источника и вероятность его выбора,
+// -1 - все источники под горизонтом
+int SampleLightTree(const glm::vec3& p, const glm::vec3& n, PathSampler& sampler, float& pdf);
+
+// Вероятности выбора всех источников сразу (индекс = индекс в allLights), один обход дерева
+void LightTreePdfs(const glm::vec3& p, const glm::vec3& n, std::vector<float>& pdfs);
+
+// Сверка дерева на случайных сценах от 3 до 100k источников: сумма вероятностей, pdf выбранного
+// источника против LightTreePdfs, ненулевая вероятность у всех источников с вкладом; ошибка оценки
+// освещённости и время выборки против равномерного выбора. Без GL, false - проверки не прошли.
+// Запуск: postframe-logic --bench-lighttree
+bool RunLightTreeBenchmark();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Файл, отображённый в память только на чтение (mmap / MapViewOfFile).
+// Страницы подтягиваются ОС по требованию, поэтому большой файл не копируется в RAM целиком
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+
+private:
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
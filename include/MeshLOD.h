@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "GPUMeshTriangle.h"
+
+// Один уровень детализации меша: свой корень BVH внутри allBVHNodes
+struct MeshLOD {
+    int bvhRootIndex;
+    int triCount;
+};
+
+struct LODSettings {
+    bool enabled = true;
+    size_t interactiveBudget = 200000; // Бюджет треугольников на меш при навигации
+    float levelRatio = 0.25f;          // Во сколько раз уменьшается каждый следующий уровень
+    int maxLevels = 4;                 // Без учёта полного (нулевого) уровня
+};
+
+extern LODSettings lodSettings;
+
+// Ключ сварки вершин: координаты побитово. В GPUMeshTriangle вершины продублированы, но у общих
+// вершин совпадают до бита. Общий для упрощения и индексированной геометрии (ModelLoader.cpp)
+struct PosKey {
+    uint32_t x, y, z;
+    bool operator==(const PosKey& o) const { return x == o.x && y == o.y && z == o.z; }
+};
+
+struct PosKeyHash {
+    size_t operator()(const PosKey& k) const {
+        return (size_t)k.x * 73856093u ^ (size_t)k.y * 19349663u ^ (size_t)k.z * 83492791u;
+    }
+};
+
+inline PosKey MakePosKey(const glm::vec3& p) {
+    PosKey key;
+    std::memcpy(&key.x, &p.x, 4); std::memcpy(&key.y, &p.y, 4); std::memcpy(&key.z, &p.z, 4);
+    return key;
+}
+
+// allMeshLODs[i] - уровни объекта allObjects[i], [0] - полная детализация
+extern std::vector<std::vector<MeshLOD>> allMeshLODs;
+
+// Упрощение по квадрикам ошибки (Garland-Heckbert), сворачиваем рёбра пока не дойдём до targetTriCount
+std::vector<GPUMeshTriangle> SimplifyMesh(const std::vector<GPUMeshTriangle>& tris, size_t targetTriCount);
+
+// Уровень, который влезает в бюджет (самый детальный из подходящих)
+int PickLODForBudget(int objectIdx, size_t triBudget);
+
+// Переключает bvhRootIndex у allObjects. Возвращает true, если что-то поменялось
+bool ApplyLOD(bool fullDetail);
+
+// Сколько треугольников сейчас реально трассируется
+size_t ActiveTriangleCount();
@@ -6,6 +6,44 @@
 
 extern std::vector<GPUMeshTriangle> allTriangles;
 
+struct GeometrySettings {
+    bool quantizePositions = false; // Хранить BLAS в 16 битах на компоненту (до самого GPU)
+    bool indexedVertices = false;   // Общие вершины + индексы вместо трёх копий на треугольник (если не quantizePositions)
+    int maxMaterialTextureSize = 2048; // Base color картинки крупнее этого уменьшаем box-фильтром
+};
+
+extern GeometrySettings geometrySettings;
+
+// Тот же порядок, что и allTriangles. Заполняется только при geometrySettings.quantizePositions
+extern std::vector<GPUQuantTriangle> allQuantTriangles;
+
+// Индексированная геометрия, тот же порядок треугольников. Заполняется только при geometrySettings.indexedVertices
+extern std::vector<float> allVertices; // xyz подряд, без паддинга
+extern std::vector<GPUIndexedTriangle> allIndexedTriangles;
+
+// UV и материалы текстурированных треугольников (GPUMeshTriangle::attribId указывает сюда)
+extern std::vector<GPUTriangleAttrib> allTriangleAttribs;
+extern std::vector<GPUMaterial> allMaterials;
+
+// Слои одной корзины для GL_TEXTURE_2D_ARRAY: layerCount квадратов layerSize x layerSize в RGBA8
+struct MaterialLayers {
+    int layerSize = 1;
+    int layerCount = 0;
+    std::vector<unsigned char> pixels;
+};
+
+// Раскладывает base color картинки всех загруженных моделей по корзинам размера (MATERIAL_TEX_BUCKETS штук)
+// и заполняет слой, корзину и uvRect материалов. Картинки после этого освобождаются
+std::vector<MaterialLayers> PackMaterialLayers();
+
 void LoadGLTF(const std::string& filename, glm::vec3 offset, float scale);
 
+// Выбрасывает всю загруженную геометрию, BVH, LOD и материалы - перед повторной загрузкой
+// с другими geometrySettings (квантование снапает вершины при загрузке, поэтому только так)
+void ClearScene();
+
+// Проверка ридера аксессоров (sparse поверх базы, нормализованные целые) на синтетическом glTF.
+// Запуск: postframe-logic --test-loader
+bool RunLoaderSelfTest();
+
 void CreateTestPyramid();
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <glm/glm.hpp>
+
+// Обходы сцены на CPU, повторяют pt_common.glsl: checkScene (ближайшее пересечение) и isOccluded (any-hit).
+// Работают по allObjects/allBVHNodes и треугольникам выбранного GeometryFormat - для сверки с шейдером
+// и для запросов к сцене без GPU
+
+struct RayHit {
+    float t = 1e10f;
+    int objId = -1;              // Индекс в allObjects, 10 - пол (как в шейдере)
+    int triIdx = -1;
+    glm::vec2 bary = glm::vec2(0.0f);
+};
+
+// Ближайшее пересечение: true, если нашлось что-то ближе hit.t
+bool TraceClosest(const glm::vec3& ro, const glm::vec3& rd, int geometryFormat, float floorSize, RayHit& hit);
+
+// Есть ли пересечение ближе maxT. Выходит на первом найденном, барицентрики и нормали не считает
+bool TraceOccluded(const glm::vec3& ro, const glm::vec3& rd, float maxT, int geometryFormat, float floorSize);
+
+// Сверка обходов с перебором всех треугольников и замер скорости, для каждого формата геометрии
+// и для стека обхода 8 (как в шейдере), 2 и 1, плюс вырожденное дерево глубины MAX_BVH_DEPTH.
+// Модель грузится заново (по умолчанию та же, что в main), GL не нужен. false - нашлись расхождения.
+// Запуск: postframe-logic --bench-rayquery [model.glb]
+bool RunRayQueryBenchmark(const std::string& modelPath = "assets/logo.glb");
@@ -0,0 +1,64 @@
+#ifndef SAMPLE_SCHEDULER_H
+#define SAMPLE_SCHEDULER_H
+
+#include <glad/gl.h>
+#include <deque>
+
+// Планировщик сэмплов кадра по GPU-времени. Цикл накопления обёрнут в GL_TIME_ELAPSED (кольцо запросов,
+// читается без ожидания), из замеров - сглаженная цена одного сэмпла на пиксель. Перед циклом plan()
+// говорит, сколько сэмплов влезет в бюджет кадра, и цикл отправляет ровно столько, не глядя на часы CPU.
+// Чтобы CPU не убегал от GPU дальше чем на maxFramesInFlight кадров, после каждого кадра ставится фенс
+class SampleScheduler {
+public:
+    bool enabled = true;
+    int maxFramesInFlight = 2;
+    float budgetFraction = 0.9f; // Запас на ошибку прогноза
+
+    float predictedSampleMs = 0.0f; // Прогноз последнего plan()
+    float measuredSampleMs = 0.0f;  // Последний замер, пересчитанный на текущее разрешение
+    float fenceWaitMs = 0.0f;       // Сколько CPU простоял на фенсах в этом кадре
+
+    SampleScheduler();
+    ~SampleScheduler();
+
+    SampleScheduler(const SampleScheduler&) = delete;
+    SampleScheduler& operator=(const SampleScheduler&) = delete;
+
+    // Начало кадра: ждёт фенсы сверх maxFramesInFlight и забирает готовые замеры.
+    // В режиме низкой задержки вызывается до ожидания FramePacer и опроса ввода
+    void beginFrame();
+
+    // Цена сэмпла в секундах на pixelCount пикселей, < 0 - замеров ещё нет
+    float sampleSeconds(int pixelCount) const;
+
+    // Был ли в этом beginFrame новый замер (по нему решает DynamicResolution)
+    bool hasNewMeasurement() const { return newMeasurement; }
+
+    // Сколько сэмплов отправить: budgetSeconds - GPU-время кадра на трассировку
+    int plan(float budgetSeconds, int pixelCount, int maxSamples);
+
+    // Скобки вокруг цикла накопления
+    void beginSamples(int pixelCount);
+    void endSamples(int samples);
+
+    // После отправки кадра целиком (SwapBuffers)
+    void endFrame();
+
+private:
+    static const int kSlots = 4;
+    struct Slot {
+        GLuint query = 0;
+        int samples = 0;
+        int pixels = 0;
+        bool pending = false;
+    };
+    Slot slots[kSlots];
+    int frame = 0;
+    Slot* active = nullptr;
+
+    double secondsPerPixelSample = -1.0; // Сглаженное
+    bool newMeasurement = false;
+    std::deque<GLsync> fences;
+};
+
+#endif
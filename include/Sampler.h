@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Генераторы случайных чисел путей, копия assets/shaders/pt_sampler.glsl (результаты совпадают бит в бит).
+// SAMPLER_LCG - старый линейный конгруэнтный генератор, SAMPLER_SOBOL - Sobol со скремблированием Оуэна
+enum SamplerType { SAMPLER_LCG = 0, SAMPLER_SOBOL = 1 };
+
+// Случайность одного сэмпла для шейдеров: u_seed1 (LCG), u_sampleIndex и u_samplerSeed (Sobol)
+struct SampleSeed {
+    glm::vec2 lcg = glm::vec2(0.0f);
+    int index = 0;    // Номер сэмпла с начала накопления
+    int scramble = 0; // Меняется при каждом сбросе накопления
+};
+
+// 32-битная точка Sobol в измерении dim (0..3)
+uint32_t SobolSample(uint32_t index, uint32_t dim);
+
+// Ключ скремблирования пикселя, как samplerPixelKey в шейдере
+uint32_t SamplerPixelKey(uint32_t x, uint32_t y, int32_t samplerSeed);
+
+// Генератор одного пути пикселя: каждый next() - следующее измерение (rand() в шейдере)
+struct PathSampler {
+    SamplerType type;
+    uint32_t state; // LCG: состояние, Sobol: номер следующего измерения
+    uint32_t key;
+    uint32_t index;
+
+    PathSampler(SamplerType type, uint32_t x, uint32_t y, const SampleSeed& seed);
+    float next();
+};
+
+// Сходимость на тестовых интегралах: RMSE от числа сэмплов на пиксель для LCG и Sobol, таблица в std::cout.
+// Запуск: postframe-logic --bench-sampler
+void RunSamplerBenchmark();
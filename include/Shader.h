@@ -4,38 +4,124 @@
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdint>
+#include <vector>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// Программа из пары файлов (vertex + fragment) или из одного compute-шейдера.
+//  - #include "file" раскрывается относительно файла, который его подключает (каждый файл один раз)
+//  - Бинарник программы кэшируется в cache/shaders по хэшу исходников и строки драйвера
+//  - С GL_KHR/ARB_parallel_shader_compile компиляция идёт в потоках драйвера, готовность опрашивается без блокировки
+//  - pollReload() раз в кадр следит за mtime файлов (включая подключённые) и подменяет программу, когда новая собралась
 class Shader {
 public:
-    unsigned int ID;
-    Shader(const char* vertexPath, const char* fragmentPath);
-    void use() { glUseProgram(ID); }
-    void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    unsigned int ID = 0;
+    // defines - строки вида "NAME VALUE", вставляются как #define сразу после #version (для пермутаций)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = {});
+    explicit Shader(const char* computePath, const std::vector<std::string>& defines = {});
+    ~Shader();
+
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+
+    void use() {
+        if (!ID) waitForInitialBuild();
+        glUseProgram(ID);
+    }
+
+    // Без блокировки: собрана ли программа (первая сборка могла ещё не закончиться)
+    bool isReady();
+
+    // Возвращает true, если программа подменилась (юниформы надо выставить заново)
+    bool pollReload();
+
+    // Хэш имени юниформа (FNV-1a). constexpr - для литералов компилятор может посчитать его сам
+    static constexpr uint64_t HashName(std::string_view name) {
+        uint64_t h = 1469598103934665603ull;
+        for (char c : name) { h ^= (unsigned char)c; h *= 1099511628211ull; }
+        return h;
+    }
+
+    // Локация из кэша, собранного после линковки. Без std::string и без похода в драйвер.
+    // Промах кэша уходит в glGetUniformLocation и тоже кэшируется; имя, которого в программе нет,
+    // печатается один раз
+    GLint location(std::string_view name) const {
+        auto it = uniformLocations.find(HashName(name));
+        return it != uniformLocations.end() ? it->second : lookupLocation(name, true);
+    }
+
+    // Есть ли активный юниформ, без предупреждения - для общих настроек ядер, где он нужен не всем
+    bool hasUniform(std::string_view name) const {
+        auto it = uniformLocations.find(HashName(name));
+        return (it != uniformLocations.end() ? it->second : lookupLocation(name, false)) >= 0;
+    }
+
+    void setMat4(std::string_view name, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
-    void setFloat(const std::string &name, float value) const {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setFloat(std::string_view name, float value) const {
+    glUniform1f(location(name), value);
     }
 
-    void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setInt(std::string_view name, int value) const {
+        glUniform1i(location(name), value);
     }
 
-    void setVec2(const std::string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec2(std::string_view name, const glm::vec2 &value) const {
+        glUniform2fv(location(name), 1, &value[0]);
     }
 
-    void setVec3(const std::string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(std::string_view name, const glm::vec3 &value) const {
+        glUniform3fv(location(name), 1, &value[0]);
     }
 
-    void setBool(const std::string &name, bool value) const {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    void setBool(std::string_view name, bool value) const {
+    glUniform1i(location(name), (int)value);
     }
+
+private:
+    struct Stage {
+        GLenum type;
+        std::string path;
+    };
+
+    // Сборка, которая может ещё идти в потоках драйвера
+    struct Build {
+        GLuint program = 0;
+        std::vector<GLuint> shaders; // Параллельно stages, пока программа не слинкована
+        uint64_t hash = 0;
+        bool fromBinary = false;
+    };
+
+    struct WatchedFile {
+        std::string path;
+        long long writeTime;
+    };
+
+    void init();
+    bool readSources(std::vector<std::string>& codes);
+    Build startBuild(const std::vector<std::string>& codes);
+    bool isBuildDone(const Build& b) const;
+    bool finishBuild(Build& b);
+    void discardBuild(Build& b);
+    void waitForInitialBuild();
+    void cacheUniformLocations();
+    GLint lookupLocation(std::string_view name, bool warn) const;
+
+    std::vector<Stage> stages;
+    std::vector<std::string> defines;
+    std::vector<WatchedFile> watchedFiles;
+    std::chrono::steady_clock::time_point lastWatchCheck;
+
+    Build initial;
+    Build reloading;
+    mutable std::unordered_map<uint64_t, GLint> uniformLocations; // -1 - имени в программе нет (уже предупредили)
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,56 @@
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include "Shader.h"
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+// Набор специализаций одной пары шейдеров. Ключ - упакованные флаги фич, на каждый ключ своя
+// программа с #define (бинарник кэшируется Shader по хэшу исходника, т.е. отдельно для каждой комбинации).
+// Сборка идёт в фоне: пока специализация не готова, get() возвращает nullptr и рендер берёт общую программу
+class ShaderPermutations {
+public:
+    ShaderPermutations(const char* vertexPath, const char* fragmentPath)
+        : vertexPath(vertexPath), fragmentPath(fragmentPath) {}
+
+    // makeDefines вызывается только при первом запросе ключа
+    template <typename MakeDefines>
+    Shader* get(uint64_t key, MakeDefines&& makeDefines) {
+        auto it = programs.find(key);
+        if (it == programs.end()) {
+            it = programs.emplace(key, Entry{std::make_unique<Shader>(vertexPath.c_str(), fragmentPath.c_str(), makeDefines()), false}).first;
+        }
+        Entry& e = it->second;
+        if (!e.ready) {
+            if (!e.shader->isReady()) return nullptr;
+            e.ready = true;
+            if (onReady) onReady(*e.shader);
+        }
+        return e.shader.get();
+    }
+
+    // Горячая перезагрузка всех собранных специализаций
+    void pollReload() {
+        for (auto& p : programs) {
+            if (p.second.ready && p.second.shader->pollReload() && onReady) onReady(*p.second.shader);
+        }
+    }
+
+    size_t size() const { return programs.size(); }
+
+    // Вызывается, когда программа собралась или перезагрузилась (выставить сэмплеры и т.п.)
+    std::function<void(Shader&)> onReady;
+
+private:
+    struct Entry {
+        std::unique_ptr<Shader> shader;
+        bool ready;
+    };
+
+    std::string vertexPath, fragmentPath;
+    std::unordered_map<uint64_t, Entry> programs;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#include <glad/gl.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageMips.h"
+#include "MappedFile.h"
+
+// Дисковый кэш декодированных текстур.
+// Ключ - хэш содержимого исходного файла, внутри готовая мип-цепочка (RGBA8 или BC1/BC3).
+// Контейнер читается через mmap, так что на повторном запуске нет ни stbi_load, ни копии RGBA в куче
+
+enum class CachedFormat : uint32_t { RGBA8 = 0, BC1 = 1, BC3 = 2 };
+
+struct TextureCacheSettings {
+    bool enabled = true;
+    bool compress = false;                    // BC1 без альфы / BC3 с альфой, сжимаем на CPU при записи
+    std::string directory = "cache/textures";
+};
+
+extern TextureCacheSettings textureCacheSettings;
+
+// Заголовок контейнера, за ним таблица уровней и данные (каждый уровень выровнен на 16 байт)
+struct CachedTextureHeader {
+    char magic[4];        // "PTXC"
+    uint32_t version;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t width, height;
+    uint32_t levels;
+    uint32_t format;      // CachedFormat
+    uint32_t alpha;
+    uint32_t pad;
+};
+
+struct CachedMipEntry {
+    uint32_t width, height;
+    uint64_t offset;      // От начала файла
+    uint64_t size;
+};
+
+// Контейнер либо отображён с диска, либо лежит в памяти (если записать кэш не удалось)
+class CachedTexture {
+public:
+    // Открывает файл кэша и проверяет, что он собран из того же исходника и в том же формате
+    bool open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, bool alpha, CachedFormat format);
+    bool adopt(std::vector<unsigned char>&& bytes);
+    void close();
+
+    bool isOpen() const { return base != nullptr; }
+    int levels() const { return (int)header().levels; }
+    const CachedTextureHeader& header() const { return *reinterpret_cast<const CachedTextureHeader*>(base); }
+    const CachedMipEntry& level(int i) const { return mipTable[i]; }
+    const unsigned char* levelData(int i) const { return base + mipTable[i].offset; }
+
+    bool compressed() const { return header().format != (uint32_t)CachedFormat::RGBA8; }
+    GLenum internalFormat() const;
+
+private:
+    bool validate(size_t size);
+
+    MappedFile file;
+    std::vector<unsigned char> memory;
+    const unsigned char* base = nullptr;
+    const CachedMipEntry* mipTable = nullptr;
+};
+
+uint64_t HashBytes(const unsigned char* data, size_t size);
+
+// Какой формат писать для текстуры с учётом настроек и поддержки S3TC драйвером
+CachedFormat PreferredCacheFormat(bool alpha);
+
+std::string TextureCachePath(uint64_t sourceHash, bool alpha, CachedFormat format);
+
+// Собирает контейнер в памяти (при необходимости сжимая уровни)
+std::vector<unsigned char> BuildTextureContainer(uint64_t sourceHash, uint64_t sourceSize, bool alpha, CachedFormat format, const std::vector<MipLevel>& mips);
+
+// Блочное сжатие одного уровня: BC1 (8 байт на блок 4x4) или BC3 (16 байт)
+void CompressBC(const MipLevel& mip, CachedFormat format, std::vector<unsigned char>& out);
+
+// Главная точка входа: хэшируем исходник, берём кэш или декодируем, строим мипы и пишем кэш.
+// Изображение всегда переворачивается по вертикали, как и в Texture
+bool LoadTextureCached(const std::string& sourcePath, bool alpha, CachedTexture& out);
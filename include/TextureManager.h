@@ -0,0 +1,84 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <glad/gl.h>
+#include "TextureCache.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Асинхронная загрузка текстур:
+//  - stbi_load и мип-цепочка считаются в рабочих потоках (или берутся из дискового кэша, см. TextureCache.h)
+//  - в GL-поток готовые уровни уходят через persistent-mapped PBO, по несколько мипов за кадр
+//  - пока текстура не загружена целиком, getID() отдаёт серую заглушку 1x1
+class TextureManager {
+public:
+    explicit TextureManager(int workerCount = 0);
+    ~TextureManager();
+
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // Ставит файл в очередь, возвращает хэндл. Вызывать из GL-потока
+    int request(const char* path, bool alpha = false);
+
+    // Раз в кадр из GL-потока: заливает готовые мипы. Возвращает, сколько текстур стало резидентными
+    int update();
+
+    unsigned int getID(int handle) const;
+    bool isResident(int handle) const;
+    int pendingCount() const;
+
+    void bind(int handle, unsigned int unit = 0) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, getID(handle));
+    }
+
+    int maxMipsPerFrame = 4;                   // Сколько уровней заливаем за один update()
+    size_t maxBytesPerFrame = 16 * 1024 * 1024; // Бюджет копирования за кадр
+
+private:
+    enum class State { Queued, Decoded, Uploading, Resident, Failed };
+
+    struct Entry {
+        std::string path;
+        bool alpha = false;
+        std::atomic<State> state{State::Queued};
+        unsigned int id = 0;
+        int nextLevel = -1;           // Следующий уровень на заливку (идём от 1x1 к 0)
+        CachedTexture data;
+    };
+
+    // Кольцо staging-буфера: по одному слоту на кадр в полёте, у каждого свой fence
+    static const int kStagingSlots = 3;
+    static const size_t kStagingSlotSize = 16 * 1024 * 1024;
+
+    void workerLoop();
+    void createPlaceholder();
+    void createStaging();
+    bool uploadLevel(Entry& e, int level, size_t& slotOffset);
+
+    std::vector<std::unique_ptr<Entry>> entries;
+    std::vector<int> uploading;                // Хэндлы, которые сейчас льются в GL (только GL-поток)
+
+    std::vector<std::thread> workers;
+    mutable std::mutex queueMutex;
+    std::condition_variable queueCv;
+    std::deque<int> decodeQueue;
+    std::vector<int> decodedQueue;
+    bool stopping = false;
+
+    unsigned int placeholder = 0;
+    unsigned int stagingPBO = 0;
+    unsigned char* stagingPtr = nullptr;       // nullptr - нет ARB_buffer_storage, льём напрямую
+    GLsync slotFences[kStagingSlots] = {};
+    int currentSlot = 0;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef WAVEFRONT_TRACER_H
+#define WAVEFRONT_TRACER_H
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Sampler.h"
+#include "Framebuffer.h"
+
+// Волновой трассировщик на compute-шейдерах (assets/shaders/pt_wf_*.glsl).
+// Вместо одного фрагментного прохода путь разбит на ядра generate -> (extend -> shade -> shadow) x отскоки -> accumulate,
+// которые обмениваются очередями лучей в SSBO. Завершённые пути в следующую очередь не попадают,
+// размер запуска берётся из счётчика очереди (glDispatchComputeIndirect) без чтения на CPU.
+// Прямой свет первичных попаданий может идти через ReSTIR DI: ядра restir_temporal/restir_spatial
+// между extend и shade первого отскока, резервуары пикселей живут между сэмплами
+class WavefrontTracer {
+public:
+    enum Kernel { KERNEL_GENERATE, KERNEL_EXTEND, KERNEL_RESTIR, KERNEL_SHADE, KERNEL_SHADOW, KERNEL_ACCUMULATE, KERNEL_COUNT };
+    static const char* KernelName(int kernel);
+
+    struct ReSTIRSettings {
+        bool enabled = true;
+        int candidates = 8;   // Кандидатов RIS на пиксель
+        int neighbors = 3;    // Соседей в пространственном проходе
+        float radius = 20.0f; // Радиус поиска соседей, пикселей
+    };
+    ReSTIRSettings restir;
+
+    WavefrontTracer();
+    ~WavefrontTracer();
+
+    WavefrontTracer(const WavefrontTracer&) = delete;
+    WavefrontTracer& operator=(const WavefrontTracer&) = delete;
+
+    // Раз в кадр: забирает готовые замеры прошлых кадров, первый сэмпл этого кадра будет замерен
+    void beginFrame();
+
+    struct SampleParams {
+        int width = 0, height = 0;
+        int bounces = 1;
+        int shadowRaysPerPath = 1; // Теневых лучей на точку (размер очереди теней)
+        float samplePart = 1.0f;   // 1 - сброс накопления
+        SampleSeed seed;
+        glm::mat4 view = glm::mat4(1.0f); // Камера из UBO: по ней следующий сэмпл репроецирует резервуары ReSTIR
+        bool adaptive = false;    // Маска AdaptiveSampler построена, пути генерируются только для активных тайлов
+        bool reproject = false;   // Камера сдвинулась: история накопления берётся репроекцией (pt_reproject.glsl)
+        glm::mat4 historyView = glm::mat4(1.0f); // Камера, которой снято накопленное в prev
+        glm::vec2 historyResolution = glm::vec2(0.0f); // И его разрешение (под-прямоугольник prev)
+        float maxHistory = 32.0f;
+    };
+
+    // Один сэмпл на пиксель. UBO кадра, буферы сцены, пол на юните 2 и материалы на MATERIAL_TEX_UNITS уже привязаны.
+    // prev - накопленное, в out пишется накопленное с этим сэмплом
+    void traceSample(const SampleParams& params, const Framebuffer& prev, const Framebuffer& out);
+
+    // Сбросить историю резервуаров (сцена поменялась целиком)
+    void resetHistory() { hasHistory = false; }
+
+    // Горячая перезагрузка ядер. true - если что-то подменилось
+    bool pollReload();
+
+    float kernelMs[KERNEL_COUNT] = {}; // Сглаженное время ядер за один сэмпл (все отскоки вместе)
+
+private:
+    static const int kTimerSlots = 3;      // Кадры в полёте: результат читается через пару кадров, без ожидания
+    static const int kMaxTimestamps = 64;
+
+    struct TimerSlot {
+        GLuint queries[kMaxTimestamps] = {};
+        int kernels[kMaxTimestamps] = {}; // Какое ядро идёт после метки i
+        int count = 0;
+        bool pending = false;
+    };
+
+    void ensureCapacity(int pixelCount, int shadowCount);
+    void resetQueue(int queue);
+    void dispatchIndirect(int queue);
+    void stamp(int nextKernel);
+    void collectTimings();
+
+    Shader generate, extend, restirTemporal, restirSpatial, shade, shadow, accumulate;
+    bool samplersSet = false;
+
+    GLuint pathBuffer = 0, rayBuffers[2] = {}, hitBuffer = 0, shadowBuffer = 0, counterBuffer = 0;
+    int pathCapacity = 0, shadowCapacity = 0;
+
+    GLuint reservoirBuffers[2] = {}; // Binding 19 - после временного прохода, 20 - итог и история для следующего сэмпла
+    glm::mat4 prevView = glm::mat4(1.0f);
+    int historyWidth = 0, historyHeight = 0;
+    bool hasHistory = false;
+
+    TimerSlot timers[kTimerSlots];
+    int timerFrame = 0;
+    TimerSlot* activeTimer = nullptr;
+    bool timeNextSample = false;
+};
+
+#endif
@@ -6,10 +6,22 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "Shader.h"
-#include "Texture.h"
+#include "ShaderPermutations.h"
+#include "FrameUniforms.h"
+#include "TextureManager.h"
+#include "WavefrontTracer.h"
+#include "AdaptiveSampler.h"
+#include "Denoiser.h"
+#include "DynamicResolution.h"
+#include "GpuProfiler.h"
+#include "SampleScheduler.h"
+#include "FramePacer.h"
 #include "LightSystem.h"
 #include "ModelLoader.h"
 #include "BVH.h"
+#include "MeshLOD.h"
+#include "Sampler.h"
+#include "RayQuery.h"
 
 #include "themes.h"
 
@@ -23,7 +35,6 @@
 #include <algorithm>
 #include <vector>
 #include <iostream>
-#include <thread>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtc/quaternion.hpp>
@@ -141,7 +152,26 @@ void PrintGPUInfo() {
 }
 
 // --- MAIN ---
-int main() {
+int main(int argc, char** argv) {
+    // Сравнение генераторов без окна и GL
+    if (argc > 1 && std::string(argv[1]) == "--bench-sampler") {
+        RunSamplerBenchmark();
+        return 0;
+    }
+    // Сверка CPU-обходов сцены с перебором и их скорость, тоже без окна
+    if (argc > 1 && std::string(argv[1]) == "--bench-rayquery") {
+        bool match = argc > 2 ? RunRayQueryBenchmark(argv[2]) : RunRayQueryBenchmark();
+        return match ? 0 : 1;
+    }
+    // Сверка вероятностей дерева источников и сравнение с равномерным выбором, без окна
+    if (argc > 1 && std::string(argv[1]) == "--bench-lighttree") {
+        return lightsys::RunLightTreeBenchmark() ? 0 : 1;
+    }
+    // Ридер аксессоров glTF на синтетических данных, без окна
+    if (argc > 1 && std::string(argv[1]) == "--test-loader") {
+        return RunLoaderSelfTest() ? 0 : 1;
+    }
+
     int loadNow = 0;
 
     // Init GLFW
@@ -197,50 +227,182 @@ int main() {
     glEnableVertexAttribArray(1); glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
     // 4. Shaders & Textures
-    Shader ptShader("assets/shaders/screen_v.glsl", "assets/shaders/pt_fragment.glsl");
-    Shader screenShader("assets/shaders/screen_v.glsl", "assets/shaders/screen_f.glsl");
-    Texture logoTex("assets/program_base/logo-bg.png", true); 
-    Texture floorTex("assets/base_tex.png", false);
-    Texture renderFloorTex("assets/render_base_tex.png", true);
-
-    LoadGLTF("assets/logo.glb", glm::vec3(0.0f, 0.5f, 0.0f), 1.0f);
-
-    if (allTriangles.empty()) {
-        std::cout << "No GLTF loaded, using Test Pyramid." << std::endl;
-        CreateTestPyramid();
-    }
+    // Программы держат GL-объекты - на куче, чтобы удалить их до glfwTerminate
+    Shader* ptShader = new Shader("assets/shaders/screen_v.glsl", "assets/shaders/pt_fragment.glsl");
+    Shader* screenShader = new Shader("assets/shaders/screen_v.glsl", "assets/shaders/screen_f.glsl");
+
+    // Специализации pt_fragment под текущий набор фич; ptShader - общая программа на юниформах,
+    // рисует, пока нужная специализация собирается в фоне
+    ShaderPermutations* ptPermutations = new ShaderPermutations("assets/shaders/screen_v.glsl", "assets/shaders/pt_fragment.glsl");
+
+    // Сэмплеры всегда на одних и тех же юнитах - выставляем один раз (и после горячей перезагрузки)
+    auto setupPtSamplers = [](Shader& s) {
+        s.use();
+        s.setInt("u_sample", 0);
+        s.setInt("u_floorTex", 2);
+        // Корзины материалов по своим юнитам; без локации массив остался бы на юните 0 вместе с u_sample
+        for (int b = 0; b < MATERIAL_TEX_BUCKETS; b++) {
+            std::string name = "u_materialTex[" + std::to_string(b) + "]";
+            if (!s.hasUniform(name)) std::cout << "ERROR: " << name << " has no location in pt_fragment" << std::endl;
+            s.setInt(name, MATERIAL_TEX_UNITS[b]);
+        }
+        s.setInt("u_moments", 4);
+        s.setInt("u_prevGBuffer", 5);
+        s.setInt("u_prevAlbedo", 6);
+    };
+    setupPtSamplers(*ptShader);
+    ptPermutations->onReady = setupPtSamplers;
+
+    // Камера и параметры рендера - в std140 UBO, заливается раз в кадр
+    GLuint frameUBO;
+    glGenBuffers(1, &frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, frameUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    // Текстуры грузятся в фоне, до готовности вместо них биндится заглушка
+    TextureManager* textures = new TextureManager();
+    int logoTex = textures->request("assets/program_base/logo-bg.png", true);
+    int floorTex = textures->request("assets/base_tex.png", false);
+    int renderFloorTex = textures->request("assets/render_base_tex.png", true);
+
+    // Тот же трассировщик на compute-ядрах, переключается в настройках
+    WavefrontTracer* wavefront = new WavefrontTracer();
+    // Маска сошедшихся тайлов для обоих трассировщиков
+    AdaptiveSampler* adaptive = new AdaptiveSampler();
+    // Фильтр накопленного кадра перед экранным проходом
+    Denoiser* denoiser = new Denoiser();
+    DynamicResolution* dynamicRes = new DynamicResolution();
+    // Время проходов на GPU для окна профайлера
+    GpuProfiler* profiler = new GpuProfiler();
+    // Сколько сэмплов влезает в кадр - по GPU-времени, а не по часам CPU
+    SampleScheduler* scheduler = new SampleScheduler();
+    // Ограничение FPS сном, а не пустым циклом
+    FramePacer* pacer = new FramePacer();
+
+    // Сцена грузится заново при смене формата геометрии в настройках (quantizePositions снапает вершины при загрузке)
+    auto loadScene = []() {
+        LoadGLTF("assets/logo.glb", glm::vec3(0.0f, 0.5f, 0.0f), 1.0f);
+
+        if (allTriangles.empty()) {
+            std::cout << "No GLTF loaded, using Test Pyramid." << std::endl;
+            CreateTestPyramid();
+        }
+    };
+    loadScene();
 
     loadNow++;
     std::cout << "Assets Loaded [" << loadNow << "/" << loadMax << "]" << std::endl;
 
-    // Создаем SSBO и грузим данные в видеокарту
-    GLuint meshSSBO;
+    // Буферы сцены создаются один раз, uploadScene только перезаливает их содержимое
+    GLuint meshSSBO, quantMeshSSBO, vertexSSBO, indexSSBO, objectSSBO, bvhSSBO, attribSSBO, materialSSBO;
     glGenBuffers(1, &meshSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, allTriangles.size() * sizeof(GPUMeshTriangle), allTriangles.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshSSBO); // Binding = 2
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); // Unbind
+    glGenBuffers(1, &quantMeshSSBO);
+    glGenBuffers(1, &vertexSSBO);
+    glGenBuffers(1, &indexSSBO);
+    glGenBuffers(1, &objectSSBO);
+    glGenBuffers(1, &bvhSSBO);
+    glGenBuffers(1, &attribSSBO);
+    glGenBuffers(1, &materialSSBO);
+
+    GLuint materialTexArrays[MATERIAL_TEX_BUCKETS];
+    glGenTextures(MATERIAL_TEX_BUCKETS, materialTexArrays);
+    for (GLuint tex : materialTexArrays) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, tex);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
 
-    loadNow++;
-    std::cout << "Meshes Sent to GPU [" << loadNow << "/" << loadMax << "]" << std::endl;
+    int geometryFormat = GEOMETRY_FULL;
+    size_t geometryBytes = 0;
+    const char* geometryName = "full";
+
+    auto uploadScene = [&]() {
+        // На GPU едет один формат геометрии (GEOMETRY_* в pt_fragment.glsl), в неиспользуемые слоты кладём заглушки
+        geometryFormat = GEOMETRY_FULL;
+        if (geometrySettings.quantizePositions && allQuantTriangles.size() == allTriangles.size() && !allQuantTriangles.empty()) geometryFormat = GEOMETRY_QUANTIZED;
+        else if (geometrySettings.indexedVertices && allIndexedTriangles.size() == allTriangles.size() && !allIndexedTriangles.empty()) geometryFormat = GEOMETRY_INDEXED;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshSSBO);
+        if (geometryFormat != GEOMETRY_FULL) glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUMeshTriangle), nullptr, GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, allTriangles.size() * sizeof(GPUMeshTriangle), allTriangles.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshSSBO); // Binding = 2
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, quantMeshSSBO);
+        if (geometryFormat == GEOMETRY_QUANTIZED) glBufferData(GL_SHADER_STORAGE_BUFFER, allQuantTriangles.size() * sizeof(GPUQuantTriangle), allQuantTriangles.data(), GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUQuantTriangle), nullptr, GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, quantMeshSSBO); // Binding = 7
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, vertexSSBO);
+        if (geometryFormat == GEOMETRY_INDEXED) glBufferData(GL_SHADER_STORAGE_BUFFER, allVertices.size() * sizeof(float), allVertices.data(), GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, 3 * sizeof(float), nullptr, GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, vertexSSBO); // Binding = 10
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexSSBO);
+        if (geometryFormat == GEOMETRY_INDEXED) glBufferData(GL_SHADER_STORAGE_BUFFER, allIndexedTriangles.size() * sizeof(GPUIndexedTriangle), allIndexedTriangles.data(), GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUIndexedTriangle), nullptr, GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, indexSSBO); // Binding = 11
+
+        size_t fullGeometryBytes = allTriangles.size() * sizeof(GPUMeshTriangle);
+        geometryBytes = fullGeometryBytes;
+        geometryName = "full";
+        if (geometryFormat == GEOMETRY_QUANTIZED) {
+            geometryBytes = allQuantTriangles.size() * sizeof(GPUQuantTriangle);
+            geometryName = "quantized";
+        } else if (geometryFormat == GEOMETRY_INDEXED) {
+            geometryBytes = allVertices.size() * sizeof(float) + allIndexedTriangles.size() * sizeof(GPUIndexedTriangle);
+            geometryName = "indexed";
+        }
+        std::cout << "Geometry: " << geometryBytes / 1024 << " KB (" << geometryName << ", full: " << fullGeometryBytes / 1024 << " KB)" << std::endl;
 
-    GLuint objectSSBO;
-    glGenBuffers(1, &objectSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, allObjects.size() * sizeof(GPUMeshObject), allObjects.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objectSSBO); // Binding 3
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, allObjects.size() * sizeof(GPUMeshObject), allObjects.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objectSSBO); // Binding 3
 
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, bvhSSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, allBVHNodes.size() * sizeof(GPUBVHNode), allBVHNodes.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, bvhSSBO);
+
+        // UV и материалы текстурированных треугольников. Пустые буферы всё равно создаём - шейдер их объявляет
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, attribSSBO);
+        if (allTriangleAttribs.empty()) glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUTriangleAttrib), nullptr, GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, allTriangleAttribs.size() * sizeof(GPUTriangleAttrib), allTriangleAttribs.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, attribSSBO); // Binding 8
+
+        // Base color картинки - по корзинам размера, в каждой один GL_TEXTURE_2D_ARRAY с мипами
+        std::vector<MaterialLayers> materialLayers = PackMaterialLayers();
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialSSBO);
+        if (allMaterials.empty()) glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GPUMaterial), nullptr, GL_STATIC_DRAW);
+        else glBufferData(GL_SHADER_STORAGE_BUFFER, allMaterials.size() * sizeof(GPUMaterial), allMaterials.data(), GL_STATIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, materialSSBO); // Binding 9
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        size_t materialBytes = 0;
+        for (int b = 0; b < MATERIAL_TEX_BUCKETS; b++) {
+            const MaterialLayers& layers = materialLayers[b];
+            glBindTexture(GL_TEXTURE_2D_ARRAY, materialTexArrays[b]);
+            if (layers.layerCount > 0) {
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layers.layerSize, layers.layerSize, layers.layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, layers.pixels.data());
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                std::cout << "Material textures: " << layers.layerCount << " layers " << layers.layerSize << "x" << layers.layerSize << std::endl;
+            } else {
+                // Пустая корзина: 1x1 без мипов и так полная для фильтра с мипами
+                const unsigned char white[4] = { 255, 255, 255, 255 };
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+            }
+            materialBytes += layers.pixels.size();
+        }
+        std::cout << "Material textures total: " << materialBytes / 1024 << " KB + mips" << std::endl;
+    };
+    uploadScene();
+
+    loadNow++;
+    std::cout << "Meshes Sent to GPU [" << loadNow << "/" << loadMax << "]" << std::endl;
     loadNow++;
     std::cout << "Objects Sent to GPU [" << loadNow << "/" << loadMax << "]" << std::endl;
-
-    GLuint bvhSSBO;
-    glGenBuffers(1, &bvhSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, bvhSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, allBVHNodes.size() * sizeof(GPUBVHNode), allBVHNodes.data(), GL_STATIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, bvhSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-    
     loadNow++;
     std::cout << "BVH Sent to GPU [" << loadNow << "/" << loadMax << "]" << std::endl;
 
@@ -272,17 +434,30 @@ int main() {
     int targetFPS = 60;
     int maxSamplesPerFrame = 1;
     float renderScalePercent = 75.0f; 
+    bool useUpscaler = true;        // Апскейл по краям в screen_f.glsl, когда рендер меньше окна
+    float upscaleSharpness = 0.3f;
     bool useRayTracing = false; 
-
-    // Биндим текстуры
-    floorTex.bind(1);
-    logoTex.bind(2);
-    renderFloorTex.bind(3);
+    bool useWavefront = false;
+    int samplerType = SAMPLER_SOBOL;
+    int samplerSeed = 0; // u_samplerSeed: новый на каждое накопление
+    bool temporalReprojection = true; // Движение камеры не сбрасывает накопление, а репроецирует его
+    int maxHistory = 32;               // Сколько сэмплов истории переживает репроекцию
+    bool reprojectNext = false;
+    glm::mat4 historyView(1.0f);       // Камера, которой снято накопленное в prevFB
+    glm::vec2 historyResolution(0.0f); // И под-прямоугольник prevFB, который оно занимает
+    bool useReSTIR = true; // Прямой свет первичных попаданий через резервуары (только в волновом режиме)
+    int maxBounces = 2;
+    int lightSamples = 1; // Теневых лучей на точку через дерево источников, 0 - по лучу на каждый источник
+    Shader* lastPtProgram = nullptr;
+    float samplesPerSecond = 0.0f; // Сглаженная скорость накопления, для сравнения форматов геометрии
+    float formatSamplesPerSecond[3] = {}; // Последняя скорость каждого формата (индекс - GEOMETRY_*), 0 - не мерили
+    bool reloadGeometry = false;   // Формат геометрии сменили в настройках - сцена грузится заново
 
     loadNow++; 
     std::cout << GREEN << "Ready to Render! [" << loadNow << "/" << loadMax << "]" << RESET << std::endl;
 
     bool showLearnWindow = false;
+    bool showProfiler = false;
 
     AddLight(glm::vec3(-4, 3, -6), 1.0f, glm::vec3(60, 48, 36));  // Теплый свет
     AddLight(glm::vec3(5, 2, 0), 0.5f, glm::vec3(0, 40, 80));     // Синий акцент
@@ -291,27 +466,42 @@ int main() {
     loadNow++;
     std::cout << "Light created [" << loadNow << "/" << loadMax << "]" << std::endl;
 
-    glGenBuffers(1, &lightSSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
-    glBufferData(GL_SHADER_STORAGE_BUFFER, allLights.size() * sizeof(GPULight), allLights.data(), GL_DYNAMIC_DRAW);
-    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, lightSSBO);
+    UploadLights();
 
     loadNow++;
     std::cout << "Lights Sent to GPU [" << loadNow << "/" << loadMax << "]" << RESET << std::endl;
 
     bool showLights = true;
-    bool useDenoise = true;
     int mySelectedId = -1;
     bool mouseWasPressed = false;
 
     // --- MAIN LOOP ---
     while (!glfwWindowShouldClose(window)) {
+        // В режиме низкой задержки ожидание здесь, чтобы ввод ниже был как можно свежее. Фенсы планировщика
+        // ждём ещё раньше: иначе простой на GPU встанет между опросом ввода и отправкой кадра
+        bool lowLatencyFrame = pacer->lowLatency;
+        if (lowLatencyFrame) scheduler->beginFrame();
+        pacer->beginFrame(targetFPS);
         float frameStartTime = (float)glfwGetTime();
         deltaTime = frameStartTime - lastFrame;
         lastFrame = frameStartTime;
 
         glfwPollEvents();
 
+        // Доливаем готовые мипы; новая текстура пола меняет картинку, поэтому сбрасываем накопление
+        if (textures->update() > 0) accumulationFrame = 1.0f;
+
+        // Горячая перезагрузка шейдеров: новая программа подменяет старую только когда уже собрана
+        if (ptShader->pollReload()) {
+            setupPtSamplers(*ptShader);
+            accumulationFrame = 1.0f;
+        }
+        ptPermutations->pollReload();
+        if (wavefront->pollReload()) accumulationFrame = 1.0f;
+        adaptive->pollReload();
+        denoiser->pollReload();
+        screenShader->pollReload();
+
         // ============================================================
         // 1. РЕЖИМ ЛАУНЧЕРА (МЕНЮ)
         // ============================================================
@@ -332,8 +522,7 @@ int main() {
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
             
             glfwSwapBuffers(window);
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(16));
+            pacer->endFrame();
             continue;
         }
 
@@ -344,20 +533,30 @@ int main() {
         int windowWidth, windowHeight;
         glfwGetFramebufferSize(window, &windowWidth, &windowHeight);
 
+        profiler->beginFrame();
+        if (!lowLatencyFrame) scheduler->beginFrame();
+
         // --- ЛОГИКА РЕСАЙЗА И БУФЕРОВ ---
-        int renderW = std::max(1, (int)(windowWidth * (renderScalePercent / 100.0f)));
-        int renderH = std::max(1, (int)(windowHeight * (renderScalePercent / 100.0f)));
+        // Scale % задаёт размер фреймбуферов, динамическое разрешение рендерит в их под-прямоугольник
+        int targetW = std::max(1, (int)(windowWidth * (renderScalePercent / 100.0f)));
+        int targetH = std::max(1, (int)(windowHeight * (renderScalePercent / 100.0f)));
 
-        if (renderW != currentRenderW || renderH != currentRenderH) {
+        if (targetW != currentRenderW || targetH != currentRenderH) {
             delete fb1; delete fb2;
-            fb1 = new Framebuffer(renderW, renderH);
-            fb2 = new Framebuffer(renderW, renderH);
+            fb1 = new Framebuffer(targetW, targetH);
+            fb2 = new Framebuffer(targetW, targetH);
             prevFB = fb1; currFB = fb2;
-            currentRenderW = renderW; currentRenderH = renderH;
+            currentRenderW = targetW; currentRenderH = targetH;
             accumulationFrame = 1.0f;
         }
 
-        bool moved = false;
+        int scaledPixels = std::max(1, (int)(targetW * dynamicRes->scale)) * std::max(1, (int)(targetH * dynamicRes->scale));
+        float sampleCost = scheduler->hasNewMeasurement() ? scheduler->sampleSeconds(scaledPixels) : -1.0f;
+        bool scaleChanged = dynamicRes->update(1.0f / (float)targetFPS, sampleCost);
+        int renderW = std::max(1, (int)(targetW * dynamicRes->scale));
+        int renderH = std::max(1, (int)(targetH * dynamicRes->scale));
+
+        bool cameraMoved = false;
 
         float t = (float)glfwGetTime();
         float speed = 3.0f;
@@ -375,17 +574,17 @@ int main() {
         allLights[1].position.z = center.y + cos(t * speed + 3.1415f) * radius - 5.0f;
         allLights[1].position.y = center.z + height;
 
-        // Обновляем данные в видеокарте
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightSSBO);
-        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, allLights.size() * sizeof(GPULight), allLights.data());
+        // Обновляем данные в видеокарте (вместе с деревом источников)
+        UploadLights();
 
-        if (useRayTracing) accumulationFrame = 1.0f;
+        // Источники двигаются каждый кадр: накопленный свет устаревает, сбрасываем ниже вместе с остальным
+        bool lightsMoved = true;
 
         // --- ВВОД ---
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) { camera.ProcessKeyboard(1, deltaTime); moved = true; }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) { camera.ProcessKeyboard(2, deltaTime); moved = true; }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) { camera.ProcessKeyboard(3, deltaTime); moved = true; }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) { camera.ProcessKeyboard(4, deltaTime); moved = true; }
+        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) { camera.ProcessKeyboard(1, deltaTime); cameraMoved = true; }
+        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) { camera.ProcessKeyboard(2, deltaTime); cameraMoved = true; }
+        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) { camera.ProcessKeyboard(3, deltaTime); cameraMoved = true; }
+        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) { camera.ProcessKeyboard(4, deltaTime); cameraMoved = true; }
 
         // Захват мыши (ПКМ)
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
@@ -395,7 +594,7 @@ int main() {
             if (firstMouse) { lastX = (float)xpos; lastY = (float)ypos; firstMouse = false; }
             float xoffset = (float)xpos - lastX; float yoffset = lastY - (float)ypos;
             lastX = (float)xpos; lastY = (float)ypos;
-            if (abs(xoffset) > 0.05f || abs(yoffset) > 0.05f) { camera.ProcessMouseMovement(xoffset, yoffset); moved = true; }
+            if (abs(xoffset) > 0.05f || abs(yoffset) > 0.05f) { camera.ProcessMouseMovement(xoffset, yoffset); cameraMoved = true; }
         } else {
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
             firstMouse = true;
@@ -408,100 +607,241 @@ int main() {
         float oldRotation = logoRotation;
         if (!isPaused) logoRotation += deltaTime * 0.8f;
 
-        if (glm::length(camera.Position - lastCamPos) > 0.01f || abs(logoRotation - oldRotation) > 0.001f) {
-            moved = true; lastCamPos = camera.Position; 
+        if (glm::length(camera.Position - lastCamPos) > 0.01f) {
+            cameraMoved = true; lastCamPos = camera.Position; 
+        }
+        bool moved = cameraMoved || abs(logoRotation - oldRotation) > 0.001f;
+        // Репроецировать есть что, только если накопление не сбрасывали по другим причинам, поэтому
+        // reprojectNext - до сброса. Смена динамического разрешения - та же репроекция с прежней камерой,
+        // сдвиг источников - репроекция на месте: история не выбрасывается, а обрезается до maxHistory сэмплов
+        bool historyStale = moved || scaleChanged || lightsMoved;
+        reprojectNext = historyStale && useRayTracing && temporalReprojection && accumulationFrame > 1.0f;
+        if (historyStale || !useRayTracing) accumulationFrame = 1.0f;
+
+        // --- LOD ---
+        // Пока летаем или в превью - упрощённые уровни, финальное накопление в RENDER - полная детализация.
+        // Смотрим только на камеру: лого крутится каждый кадр, и по общему moved полный уровень не включился бы никогда
+        bool wantFullDetail = (currentState == STATE_RENDER && useRayTracing && !cameraMoved);
+        // Новая сцена приходит с полными уровнями в корнях, ApplyLOD ниже выставит нужные
+        bool sceneReloaded = false;
+        if (reloadGeometry) {
+            reloadGeometry = false;
+            ClearScene();
+            loadScene();
+            uploadScene();
+            samplesPerSecond = 0.0f; // Скорость нового формата не смешиваем со старой
+            sceneReloaded = true;
+        }
+        if (ApplyLOD(wantFullDetail) || sceneReloaded) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectSSBO);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, allObjects.size() * sizeof(GPUMeshObject), allObjects.data());
+            accumulationFrame = 1.0f;
+            reprojectNext = false; // Геометрия другая - G-буфер истории ей не соответствует
+            wavefront->resetHistory(); // И резервуары ReSTIR прошлого кадра лежат на старых поверхностях
         }
-        if (moved || !useRayTracing) accumulationFrame = 1.0f;
 
         double mx, my;
         glfwGetCursorPos(window, &mx, &my);
         glfwGetWindowSize(window, &windowWidth, &windowHeight);
 
         // --- RENDER PASS ---
-        ptShader.use();
-
-        ptShader.setInt("u_selectedId", mySelectedId);
+        bool engineFloor = (currentState == STATE_ENGINE);
+        bool hasSelection = (mySelectedId != -1);
+        uint64_t ptKey = (useRayTracing ? 1u : 0u) | (showLights ? 2u : 0u) | (hasSelection ? 4u : 0u) | (engineFloor ? 8u : 0u)
+            | ((uint64_t)geometryFormat << 4) | ((uint64_t)maxBounces << 8) | ((uint64_t)lightSamples << 12);
+        Shader* ptProgram = ptPermutations->get(ptKey, [&]() {
+            return std::vector<std::string>{
+                "PERM_RAY_TRACING " + std::to_string(useRayTracing ? 1 : 0),
+                "PERM_LIGHT_GIZMOS " + std::to_string(showLights ? 1 : 0),
+                "PERM_SELECTION " + std::to_string(hasSelection ? 1 : 0),
+                "PERM_MAX_BOUNCES " + std::to_string(maxBounces),
+                "PERM_LIGHT_SAMPLES " + std::to_string(lightSamples),
+                "PERM_GEOMETRY_FORMAT " + std::to_string(geometryFormat),
+                std::string("PERM_FLOOR_SIZE ") + (engineFloor ? "1000.0" : "5.0"),
+            };
+        });
+        if (!ptProgram) ptProgram = ptShader;
+        if (ptProgram != lastPtProgram) {
+            std::cout << "Path tracer program: " << (ptProgram == ptShader ? "generic" : "specialized")
+                      << " (key " << ptKey << ", " << ptPermutations->size() << " variants)" << std::endl;
+            lastPtProgram = ptProgram;
+        }
+        ptProgram->use();
 
         float scaleX = (float)renderW / (float)windowWidth;
         float scaleY = (float)renderH / (float)windowHeight;
 
-        ptShader.setVec2("u_mousePos", glm::vec2((float)mx * scaleX, ((float)windowHeight - (float)my) * scaleY));
-
-        ptShader.setVec2("u_resolution", glm::vec2((float)renderW, (float)renderH));
-        ptShader.setVec3("u_pos", camera.Position);
-        ptShader.setMat4("u_view", camera.GetViewMatrix());
-        
-        ptShader.setInt("u_sample", 0);
-        ptShader.setInt("u_floorTex", 2);
-        ptShader.setInt("u_useRayTracing", useRayTracing ? 1 : 0);
-
-        ptShader.setInt("u_showLightGizmos", showLights ? 1 : 0);
+        FrameUniforms frame;
+        frame.view = camera.GetViewMatrix();
+        frame.camPos = camera.Position;
+        frame.floorSize = engineFloor ? 1000.0f : 5.0f;
+        frame.resolution = glm::vec2((float)renderW, (float)renderH);
+        frame.mousePos = glm::vec2((float)mx * scaleX, ((float)windowHeight - (float)my) * scaleY);
+        frame.useRayTracing = useRayTracing ? 1 : 0;
+        frame.showLightGizmos = showLights ? 1 : 0;
+        frame.selectedId = mySelectedId;
+        frame.geometryFormat = geometryFormat;
+        frame.maxBounces = maxBounces;
+        frame.lightSamples = lightSamples;
+        frame.samplerType = samplerType;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UBO_BINDING, frameUBO);
+
+        glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, textures->getID(logoTex));
 
         if (currentState == STATE_ENGINE)
         {
-            ptShader.setFloat("floorSize", 1000.0);
+            glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, textures->getID(floorTex));
         }
         else {
-            ptShader.setFloat("floorSize", 5.0);
+            glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, textures->getID(renderFloorTex));
         }
-
-        glActiveTexture(GL_TEXTURE1); glBindTexture(GL_TEXTURE_2D, logoTex.ID);
-
-        if (currentState == STATE_ENGINE)
-        {
-            glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, floorTex.ID);
-        }
-        else {
-            glActiveTexture(GL_TEXTURE2); glBindTexture(GL_TEXTURE_2D, renderFloorTex.ID);
+        for (int b = 0; b < MATERIAL_TEX_BUCKETS; b++) {
+            glActiveTexture(GL_TEXTURE0 + MATERIAL_TEX_UNITS[b]); glBindTexture(GL_TEXTURE_2D_ARRAY, materialTexArrays[b]);
         }
 
         // Биндинг SSBO
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, meshSSBO);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, objectSSBO);
         glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, bvhSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, quantMeshSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, attribSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, materialSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, vertexSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, indexSSBO);
 
         int samplesThisFrame = 0;
         float frameBudget = 1.0f / (float)targetFPS;
+        if (useWavefront) {
+            wavefront->beginFrame();
+            wavefront->restir.enabled = useReSTIR && useRayTracing;
+        }
 
-        // Цикл накопления сэмплов
-        do {
-            currFB->bind();
-            glViewport(0, 0, renderW, renderH);
+        // Трассировке достаётся кадр минус остальные проходы (по замерам профайлера прошлых кадров)
+        float otherPassesMs = std::max(profiler->frameMs - profiler->passMs("Path trace"), 0.0f);
+        float traceBudget = std::max(frameBudget - otherPassesMs / 1000.0f, frameBudget * 0.25f);
+        int plannedSamples = scheduler->enabled ? scheduler->plan(traceBudget, renderW * renderH, maxSamplesPerFrame) : maxSamplesPerFrame;
 
-            glActiveTexture(GL_TEXTURE0); 
-            glBindTexture(GL_TEXTURE_2D, prevFB->textureColor);
-            ptShader.setInt("u_sample", 0);
+        profiler->begin("Path trace");
+        scheduler->beginSamples(renderW * renderH);
 
-            ptShader.setFloat("u_sample_part", 1.0f / accumulationFrame);
-            ptShader.setVec2("u_seed1", glm::vec2((float)rand() / RAND_MAX, (float)rand() / RAND_MAX));
+        // Сброс без репроекции выбрасывает историю, счётчики тайлов в полёте к ней больше не относятся.
+        // Репроекция (камера, разрешение, сдвиг источников каждый кадр) историю сохраняет
+        if (accumulationFrame == 1.0f && !reprojectNext) adaptive->invalidate();
 
-            glBindVertexArray(quadVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            currFB->unbind();
+        // Цикл накопления сэмплов
+        do {
+            // Номер сэмпла для Sobol идёт от начала накопления, после сброса меняется только скремблирование
+            if (accumulationFrame == 1.0f) samplerSeed = rand();
+            SampleSeed seed;
+            seed.lcg = glm::vec2((float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+            seed.index = (int)accumulationFrame - 1;
+            seed.scramble = samplerSeed;
+
+            // Маска строится по накопленному с текущей камерой, то есть со второго сэмпла после сброса
+            bool adaptiveMask = useRayTracing &&
+                adaptive->prepareSample(renderW, renderH, accumulationFrame > 1.0f, prevFB->textureColor, prevFB->textureMoments);
+            // История прошлой камеры нужна только первому сэмплу кадра, дальше камера та же
+            bool reproject = reprojectNext && samplesThisFrame == 0;
+
+            if (useWavefront) {
+                WavefrontTracer::SampleParams params;
+                params.width = renderW;
+                params.height = renderH;
+                params.bounces = useRayTracing ? maxBounces : 1;
+                params.shadowRaysPerPath = lightSamples > 0 ? lightSamples : (int)lightsys::allLights.size();
+                params.samplePart = 1.0f / accumulationFrame;
+                params.seed = seed;
+                params.view = frame.view;
+                params.adaptive = adaptiveMask;
+                params.reproject = reproject;
+                params.historyView = historyView;
+                params.historyResolution = historyResolution;
+                params.maxHistory = (float)maxHistory;
+                wavefront->traceSample(params, *prevFB, *currFB);
+            } else {
+                currFB->bind();
+                glViewport(0, 0, renderW, renderH);
+
+                glActiveTexture(GL_TEXTURE0); 
+                glBindTexture(GL_TEXTURE_2D, prevFB->textureColor);
+                glActiveTexture(GL_TEXTURE4);
+                glBindTexture(GL_TEXTURE_2D, prevFB->textureMoments);
+                glActiveTexture(GL_TEXTURE5);
+                glBindTexture(GL_TEXTURE_2D, prevFB->textureGBuffer);
+                glActiveTexture(GL_TEXTURE6);
+                glBindTexture(GL_TEXTURE_2D, prevFB->textureAlbedo);
+
+                ptProgram->use();
+                ptProgram->setFloat("u_sample_part", 1.0f / accumulationFrame);
+                ptProgram->setInt("u_adaptive", adaptiveMask ? 1 : 0);
+                ptProgram->setInt("u_reproject", reproject ? 1 : 0);
+                ptProgram->setMat4("u_prevView", historyView);
+                ptProgram->setVec2("u_prevResolution", historyResolution);
+                ptProgram->setFloat("u_maxHistory", (float)maxHistory);
+                ptProgram->setVec2("u_seed1", seed.lcg);
+                ptProgram->setInt("u_sampleIndex", seed.index);
+                ptProgram->setInt("u_samplerSeed", seed.scramble);
+
+                glBindVertexArray(quadVAO);
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+                currFB->unbind();
+            }
 
             std::swap(prevFB, currFB);
             accumulationFrame += 1.0f;
             samplesThisFrame++;
 
             if (!useRayTracing) break;
+            // Все тайлы сошлись (по маске пару кадров назад, той же истории): дальше сэмплы только копируют накопленное
+            if (adaptiveMask && adaptive->converged()) break;
+
+        } while (samplesThisFrame < plannedSamples && (scheduler->enabled || (glfwGetTime() - frameStartTime) < (frameBudget - 0.001f)));
+        scheduler->endSamples(samplesThisFrame);
+        profiler->end();
+
+        if (useRayTracing) adaptive->readStats();
+        historyView = frame.view;
+        historyResolution = frame.resolution;
+        reprojectNext = false;
+
+        if (useRayTracing && deltaTime > 0.0f) {
+            // После сброса (смена формата геометрии) первое значение берём как есть, без разгона от нуля
+            float rate = (float)samplesThisFrame / deltaTime;
+            samplesPerSecond = samplesPerSecond > 0.0f ? glm::mix(samplesPerSecond, rate, 0.05f) : rate;
+            formatSamplesPerSecond[geometryFormat] = samplesPerSecond;
+        }
 
-        } while ((glfwGetTime() - frameStartTime) < (frameBudget - 0.001f) && samplesThisFrame < maxSamplesPerFrame);
+        // Без трассировки шума нет, растеризованный кадр идёт на экран как есть
+        GLuint screenTex = prevFB->textureColor;
+        if (denoiser->enabled && useRayTracing) {
+            profiler->begin("Denoise");
+            screenTex = denoiser->apply(*prevFB, renderW, renderH);
+            profiler->end();
+        }
 
         // --- SCREEN PASS (Upscaling) ---
+        profiler->begin("Screen");
         glViewport(0, 0, windowWidth, windowHeight);
         glClear(GL_COLOR_BUFFER_BIT);
         
-        screenShader.use(); 
-        screenShader.setVec2("u_resolution", glm::vec2((float)windowWidth, (float)windowHeight));
-        screenShader.setFloat("opacity", 1.0f);
-        screenShader.setInt("u_useDenoise", useDenoise ? 1 : 0);
+        screenShader->use(); 
+        screenShader->setVec2("u_resolution", glm::vec2((float)windowWidth, (float)windowHeight));
+        screenShader->setFloat("opacity", 1.0f);
+        screenShader->setVec2("u_inputSize", glm::vec2((float)renderW, (float)renderH));
+        screenShader->setInt("u_upscale", useUpscaler && renderW < windowWidth ? 1 : 0);
+        screenShader->setFloat("u_sharpness", upscaleSharpness);
 
         glActiveTexture(GL_TEXTURE0); 
-        glBindTexture(GL_TEXTURE_2D, prevFB->textureColor);
-        screenShader.setInt("screenTexture", 0);
+        glBindTexture(GL_TEXTURE_2D, screenTex);
+        screenShader->setInt("screenTexture", 0);
 
         glBindVertexArray(quadVAO); 
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        profiler->end();
 
         // --- GUI (ДВИЖОК) ---
         ImGui_ImplOpenGL3_NewFrame();
@@ -511,6 +851,7 @@ int main() {
         if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("Windows")) {
             ImGui::MenuItem("Learn", NULL, &showLearnWindow);
+            ImGui::MenuItem("GPU Profiler", NULL, &showProfiler);
             ImGui::EndMenu();
         }
         ImGui::EndMainMenuBar();
@@ -531,20 +872,37 @@ int main() {
 
             float btnWidth4 = ImGui::GetContentRegionAvail().x / 4.0f - 5.0f;
             if (ImGui::Checkbox("ENABLE PATH TRACING", &useRayTracing)) accumulationFrame = 1.0f;
+            if (ImGui::Checkbox("Wavefront (compute)", &useWavefront)) accumulationFrame = 1.0f;
             ImGui::Separator();
             ImGui::Checkbox("Show Light Gizmos", &showLights);
             ImGui::Separator();
-            ImGui::Checkbox("Enable Simple Denoise", &useDenoise);
+            ImGui::Checkbox("Denoise (a-trous)", &denoiser->enabled);
+            if (denoiser->enabled) {
+                ImGui::SliderInt("Filter passes", &denoiser->passes, 1, 5);
+                ImGui::SliderFloat("Edge sigma", &denoiser->sigmaColor, 0.5f, 16.0f, "%.1f", ImGuiSliderFlags_Logarithmic);
+            }
+            ImGui::Separator();
+            ImGui::Checkbox("Interactive LOD", &lodSettings.enabled);
+            if (ImGui::Checkbox("Quantized positions (16-bit)", &geometrySettings.quantizePositions)) reloadGeometry = true;
+            // Квантование важнее: при обоих флагах едут квантованные треугольники
+            if (geometrySettings.quantizePositions) ImGui::BeginDisabled();
+            if (ImGui::Checkbox("Indexed vertices", &geometrySettings.indexedVertices)) reloadGeometry = true;
+            if (geometrySettings.quantizePositions) ImGui::EndDisabled();
+            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Geometry: %s | %lu KB", geometryName, (unsigned long)(geometryBytes / 1024));
             ImGui::Separator();
 
             ImGui::Text("Global Presets");
             if (ImGui::Button("LOW", ImVec2(btnWidth4, 0))) { renderScalePercent = 50.0f; maxSamplesPerFrame = 8; accumulationFrame = 1.0f; } ImGui::SameLine();
-            if (ImGui::Button("MID", ImVec2(btnWidth4, 0))) { renderScalePercent = 75.0f; maxSamplesPerFrame = 16; accumulationFrame = 1.0f; } ImGui::SameLine();
+            if (ImGui::Button("MID", ImVec2(btnWidth4, 0))) { renderScalePercent = 67.0f; maxSamplesPerFrame = 16; accumulationFrame = 1.0f; } ImGui::SameLine();
             if (ImGui::Button("HIGH", ImVec2(btnWidth4, 0))) { renderScalePercent = 100.0f; maxSamplesPerFrame = 32; accumulationFrame = 1.0f; } ImGui::SameLine();
             if (ImGui::Button("ULTRA", ImVec2(btnWidth4, 0))) { renderScalePercent = 125.0f; maxSamplesPerFrame = 64; accumulationFrame = 1.0f; }
             
             ImGui::Separator();
             ImGui::SliderInt("Target FPS", &targetFPS, 1, 240);
+            ImGui::Combo("VSync", &pacer->vsync, pacer->adaptiveSupported ? "Off\0On\0Adaptive\0" : "Off\0On\0");
+            ImGui::Checkbox("Low-latency input", &pacer->lowLatency);
+            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Frame %.2f ms | jitter %.2f ms | worst %.2f ms | slept %.0f%%",
+                               pacer->intervalMs, pacer->jitterMs, pacer->maxDeviationMs, pacer->idlePercent);
             ImGui::Separator();
 
             if (!useRayTracing) ImGui::BeginDisabled();
@@ -553,20 +911,68 @@ int main() {
             if (ImGui::Button("16 smp", ImVec2(btnWidth4, 0))) maxSamplesPerFrame = 16; ImGui::SameLine();
             if (ImGui::Button("32 smp", ImVec2(btnWidth4, 0))) maxSamplesPerFrame = 32; ImGui::SameLine();
             if (ImGui::Button("64 smp", ImVec2(btnWidth4, 0))) maxSamplesPerFrame = 64;
+            if (ImGui::SliderInt("Bounces", &maxBounces, 1, 8)) accumulationFrame = 1.0f;
+            if (ImGui::SliderInt("Light samples", &lightSamples, 0, 8, lightSamples == 0 ? "all lights" : "%d")) accumulationFrame = 1.0f;
+            if (ImGui::Combo("Sampler", &samplerType, "LCG\0Sobol (Owen)\0")) accumulationFrame = 1.0f;
+            ImGui::Checkbox("Temporal reprojection", &temporalReprojection);
+            if (temporalReprojection) ImGui::SliderInt("History clamp", &maxHistory, 1, 256);
+            ImGui::Checkbox("Adaptive sampling", &adaptive->enabled);
+            if (adaptive->enabled) {
+                ImGui::SliderFloat("Noise threshold", &adaptive->threshold, 0.002f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderInt("Min samples", &adaptive->minSamples, 4, 128);
+            }
+            if (!useWavefront) ImGui::BeginDisabled();
+            if (ImGui::Checkbox("ReSTIR DI", &useReSTIR)) accumulationFrame = 1.0f;
+            if (useReSTIR) {
+                if (ImGui::SliderInt("Candidates", &wavefront->restir.candidates, 1, 32)) accumulationFrame = 1.0f;
+                if (ImGui::SliderInt("Neighbors", &wavefront->restir.neighbors, 0, 8)) accumulationFrame = 1.0f;
+            }
+            if (!useWavefront) ImGui::EndDisabled();
             if (!useRayTracing) ImGui::EndDisabled();
 
             ImGui::Separator();
             if (ImGui::SliderFloat("Scale %", &renderScalePercent, 1.0f, 200.0f, "%.0f%%")) accumulationFrame = 1.0f;
+            ImGui::Checkbox("GPU sample scheduler", &scheduler->enabled);
+            if (scheduler->enabled) {
+                ImGui::SliderInt("Frames in flight", &scheduler->maxFramesInFlight, 1, 4);
+                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Predicted %.2f ms/sample | fence wait %.2f ms",
+                                   scheduler->predictedSampleMs, scheduler->fenceWaitMs);
+            }
+            ImGui::Checkbox("Dynamic resolution", &dynamicRes->enabled);
+            if (dynamicRes->enabled) {
+                ImGui::SliderFloat("Min scale", &dynamicRes->minScale, 0.25f, 1.0f, "%.2f");
+                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Dynamic: %.0f%% of target | %.2f ms/sample",
+                                   dynamicRes->scale * 100.0f, dynamicRes->gpuSampleMs);
+            }
+            ImGui::Checkbox("Edge-adaptive upscale", &useUpscaler);
+            if (useUpscaler) ImGui::SliderFloat("Sharpness", &upscaleSharpness, 0.0f, 1.0f, "%.2f");
             
             ImGui::Separator();
-            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Res: %dx%d | Tris: %lu", renderW, renderH, allTriangles.size());
+            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Res: %dx%d | Tris: %lu", renderW, renderH, (unsigned long)ActiveTriangleCount());
             
             float fps = ImGui::GetIO().Framerate;
 
-            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "FPS: %.1f", fps);
+            ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "FPS: %.1f | GPU: %.2f ms", fps, profiler->frameMs);
+            if (useRayTracing) {
+                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Samples/s (%s): %.1f | %.1f Mpx/s", geometryName, samplesPerSecond, samplesPerSecond * renderW * renderH / 1e6f);
+                // Сравнимо только при тех же настройках и разрешении: значения не сбрасываются при их смене
+                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Last: full %.1f | indexed %.1f | quantized %.1f",
+                                   formatSamplesPerSecond[GEOMETRY_FULL], formatSamplesPerSecond[GEOMETRY_INDEXED], formatSamplesPerSecond[GEOMETRY_QUANTIZED]);
+                if (adaptive->enabled) {
+                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "Active tiles: %d / %d%s", adaptive->activeTiles, adaptive->totalTiles,
+                                       adaptive->converged() ? " (converged)" : "");
+                }
+            }
+            if (useWavefront) {
+                for (int k = 0; k < WavefrontTracer::KERNEL_COUNT; k++) {
+                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "%-10s %.3f ms", WavefrontTracer::KernelName(k), wavefront->kernelMs[k]);
+                }
+            }
 
             ImGui::End();
 
+            if (showProfiler) profiler->drawWindow(&showProfiler, 1000.0f / (float)targetFPS);
+
             if (showLearnWindow) 
             {
                 if (ImGui::Begin("Learn.", &showLearnWindow)) {
@@ -608,19 +1014,29 @@ int main() {
             mouseWasPressed = mouseIsDown;
         }
 
+        profiler->begin("ImGui");
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        profiler->end();
+        profiler->endFrame();
 
         glfwSwapBuffers(window);
-
-        float timeToWait = frameBudget - (float)(glfwGetTime() - frameStartTime);
-        if (timeToWait > 0.001f) {
-            std::this_thread::sleep_for(std::chrono::milliseconds((int)(timeToWait * 1000)));
-        }
-        while ((glfwGetTime() - frameStartTime) < frameBudget) {}
+        scheduler->endFrame();
+        pacer->endFrame();
     }
 
     delete fb1; delete fb2;
+    delete wavefront;
+    delete adaptive;
+    delete denoiser;
+    delete dynamicRes;
+    delete profiler;
+    delete scheduler;
+    delete pacer;
+    delete textures;
+    delete ptPermutations;
+    delete ptShader;
+    delete screenShader;
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
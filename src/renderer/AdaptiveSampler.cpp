@@ -0,0 +1,137 @@
+#include "AdaptiveSampler.h"
+
+#include <iostream>
+
+namespace {
+
+const int kTileSize = 8;            // ADAPTIVE_TILE в pt_adaptive.glsl
+const GLuint kMaskBinding = 21;
+const GLuint kMomentsUnit = 4;      // Свободный юнит после u_materialTex
+
+} // namespace
+
+AdaptiveSampler::AdaptiveSampler() : maskShader("assets/shaders/pt_adaptive_mask.glsl") {
+    // Буфер привязан всегда, даже без маски: шейдеры его объявляют
+    glGenBuffers(1, &maskBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMaskBinding, maskBuffer);
+
+    createReadback();
+}
+
+AdaptiveSampler::~AdaptiveSampler() {
+    for (GLsync& f : readbackFences) {
+        if (f) glDeleteSync(f);
+    }
+    if (readbackBuffer) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &readbackBuffer);
+    }
+    glDeleteBuffers(1, &maskBuffer);
+}
+
+void AdaptiveSampler::createReadback() {
+    // Без ARB_buffer_storage статистики нет: все тайлы считаются активными, маска работает как обычно
+    if (!GLAD_GL_ARB_buffer_storage) return;
+
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = kReadbackSlots * sizeof(GLuint);
+
+    glGenBuffers(1, &readbackBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+    readbackPtr = (const GLuint*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (!readbackPtr) {
+        std::cout << "AdaptiveSampler: persistent mapping failed, tile stats disabled" << std::endl;
+        glDeleteBuffers(1, &readbackBuffer);
+        readbackBuffer = 0;
+    }
+}
+
+bool AdaptiveSampler::prepareSample(int width, int height, bool historyValid, GLuint colorTexture, GLuint momentsTexture) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMaskBinding, maskBuffer);
+
+    int tilesX = (width + kTileSize - 1) / kTileSize, tilesY = (height + kTileSize - 1) / kTileSize;
+    // Динамическое разрешение репроецирует историю, но счётчик другой сетки тайлов с новой не сравнить
+    if (tilesX * tilesY != totalTiles) invalidate();
+    totalTiles = tilesX * tilesY;
+    maskValid = enabled && historyValid;
+    if (!statsValid) activeTiles = totalTiles;
+    if (!maskValid) return false;
+
+    if (totalTiles > maskCapacity) {
+        maskCapacity = totalTiles;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (1 + maskCapacity) * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kMaskBinding, maskBuffer);
+    }
+
+    // Счётчик тайлов обнуляется перед каждой маской
+    const GLuint zero = 0;
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, maskBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glActiveTexture(GL_TEXTURE0 + kMomentsUnit);
+    glBindTexture(GL_TEXTURE_2D, momentsTexture);
+
+    maskShader.use();
+    maskShader.setInt("u_sample", 0);
+    maskShader.setInt("u_moments", kMomentsUnit);
+    maskShader.setFloat("u_minSamples", (float)minSamples);
+    maskShader.setFloat("u_threshold", threshold);
+    glDispatchCompute((GLuint)tilesX, (GLuint)tilesY, 1);
+
+    // Маску читают фрагментный проход и ядра волнового трассировщика
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    return true;
+}
+
+void AdaptiveSampler::invalidate() {
+    epoch++;
+    statsValid = false;
+    activeTiles = totalTiles;
+}
+
+void AdaptiveSampler::readStats() {
+    if (!readbackPtr) return;
+
+    // Забираем готовые слоты от старых к новым; GPU выполняет команды по порядку,
+    // так что первый неготовый означает, что дальше ждать тоже нечего
+    for (int i = 0; i < kReadbackSlots; i++) {
+        int slot = (readbackSlot + i) % kReadbackSlots;
+        GLsync& fence = readbackFences[slot];
+        if (!fence) continue;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        glDeleteSync(fence);
+        fence = nullptr;
+        if (readbackEpochs[slot] == epoch) {
+            activeTiles = (int)readbackPtr[slot];
+            statsValid = true;
+        }
+    }
+
+    // Слот ещё не прочитан (GPU отстал больше чем на кольцо) - этот кадр пропускаем
+    if (!maskValid || readbackFences[readbackSlot]) return;
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, maskBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, readbackSlot * sizeof(GLuint), sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    readbackFences[readbackSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readbackEpochs[readbackSlot] = epoch;
+    readbackSlot = (readbackSlot + 1) % kReadbackSlots;
+}
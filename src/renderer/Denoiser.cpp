@@ -0,0 +1,80 @@
+#include "Denoiser.h"
+
+namespace {
+
+const int kGroupSize = 8; // local_size в denoise_atrous.glsl
+
+// Юниты те же, что у трассировщика: кадр на 0, моменты на 4, G-буфер на 5, альбедо на 6
+const GLuint kInputUnit = 1;
+const GLuint kColorUnit = 0;
+const GLuint kMomentsUnit = 4;
+const GLuint kGBufferUnit = 5;
+const GLuint kAlbedoUnit = 6;
+
+} // namespace
+
+Denoiser::Denoiser() : atrousShader("assets/shaders/denoise_atrous.glsl") {
+    glGenTextures(2, pingPong);
+}
+
+Denoiser::~Denoiser() {
+    glDeleteTextures(2, pingPong);
+}
+
+void Denoiser::resize(int w, int h) {
+    if (w == texWidth && h == texHeight) return;
+    texWidth = w;
+    texHeight = h;
+    for (GLuint tex : pingPong) {
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, texWidth, texHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+}
+
+GLuint Denoiser::apply(const Framebuffer& fb, int width, int height) {
+    resize(fb.width, fb.height);
+
+    glActiveTexture(GL_TEXTURE0 + kColorUnit);
+    glBindTexture(GL_TEXTURE_2D, fb.textureColor);
+    glActiveTexture(GL_TEXTURE0 + kMomentsUnit);
+    glBindTexture(GL_TEXTURE_2D, fb.textureMoments);
+    glActiveTexture(GL_TEXTURE0 + kGBufferUnit);
+    glBindTexture(GL_TEXTURE_2D, fb.textureGBuffer);
+    glActiveTexture(GL_TEXTURE0 + kAlbedoUnit);
+    glBindTexture(GL_TEXTURE_2D, fb.textureAlbedo);
+
+    atrousShader.use();
+    atrousShader.setInt("u_input", kInputUnit);
+    atrousShader.setInt("u_color", kColorUnit);
+    atrousShader.setInt("u_moments", kMomentsUnit);
+    atrousShader.setInt("u_gbuffer", kGBufferUnit);
+    atrousShader.setInt("u_albedo", kAlbedoUnit);
+    atrousShader.setFloat("u_sigmaColor", sigmaColor);
+    atrousShader.setFloat("u_sigmaNormal", sigmaNormal);
+    atrousShader.setFloat("u_sigmaDepth", sigmaDepth);
+    atrousShader.setFloat("u_sigmaAlbedo", sigmaAlbedo);
+    glUniform2i(atrousShader.location("u_size"), width, height);
+
+    GLuint groupsX = (GLuint)((width + kGroupSize - 1) / kGroupSize), groupsY = (GLuint)((height + kGroupSize - 1) / kGroupSize);
+
+    // Проход 0 пишет в pingPong[0], дальше каждый читает то, что написал предыдущий
+    int passCount = passes > 0 ? passes : 1;
+    for (int pass = 0; pass <= passCount; pass++) {
+        GLuint src = pingPong[(pass + 1) & 1], dst = pingPong[pass & 1];
+        glActiveTexture(GL_TEXTURE0 + kInputUnit);
+        glBindTexture(GL_TEXTURE_2D, src);
+        glBindImageTexture(0, dst, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+        atrousShader.setInt("u_pass", pass);
+        atrousShader.setInt("u_step", pass > 0 ? 1 << (pass - 1) : 0);
+        atrousShader.setInt("u_last", pass == passCount ? 1 : 0);
+        glDispatchCompute(groupsX, groupsY, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    return pingPong[passCount & 1];
+}
@@ -0,0 +1,54 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const float kStep = 0.05f;      // Шаг доли: мелкие колебания не перезапускают накопление
+const float kHeadroom = 0.6f;   // Вверх, только если сэмпл занимает меньше этой части бюджета
+const int kFramesDown = 2;
+const int kFramesUp = 30;
+
+} // namespace
+
+bool DynamicResolution::update(float frameBudget, float sampleSeconds) {
+    if (sampleSeconds >= 0.0f) gpuSampleMs = sampleSeconds * 1000.0f;
+
+    if (!enabled) {
+        overFrames = underFrames = 0;
+        if (scale == 1.0f) return false;
+        scale = 1.0f;
+        return true;
+    }
+    if (sampleSeconds < 0.0f) return false;
+
+    float budget = frameBudget * budgetFraction;
+    if (sampleSeconds > budget) {
+        overFrames++;
+        underFrames = 0;
+    } else if (sampleSeconds < budget * kHeadroom) {
+        underFrames++;
+        overFrames = 0;
+    } else {
+        overFrames = underFrames = 0;
+    }
+
+    // Стоимость сэмпла пропорциональна площади, поэтому доля по оси - через корень
+    float target = scale;
+    if (overFrames >= kFramesDown) {
+        target = scale * std::sqrt(budget / sampleSeconds);
+        target = std::floor(target / kStep + 1e-3f) * kStep;
+    } else if (underFrames >= kFramesUp) {
+        target = std::min(scale * std::sqrt(budget / sampleSeconds), scale + kStep);
+        target = std::round(target / kStep) * kStep;
+    }
+    target = std::clamp(target, minScale, 1.0f);
+    if (std::fabs(target - scale) < kStep * 0.5f) return false;
+
+    std::cout << "Dynamic resolution: " << (int)std::round(scale * 100.0f) << "% -> " << (int)std::round(target * 100.0f)
+              << "% (" << gpuSampleMs << " ms per sample)" << std::endl;
+    scale = target;
+    overFrames = underFrames = 0;
+    return true;
+}
@@ -15,6 +15,31 @@ Framebuffer::Framebuffer(int width, int height) : width(width), height(height) {
     // Прикрепляем текстуру к фреймбуферу
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureColor, 0);
 
+    // Остальные выходы pt_fragment.glsl
+    glGenTextures(1, &textureMoments);
+    glBindTexture(GL_TEXTURE_2D, textureMoments);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, textureMoments, 0);
+
+    glGenTextures(1, &textureGBuffer);
+    glBindTexture(GL_TEXTURE_2D, textureGBuffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, textureGBuffer, 0);
+
+    glGenTextures(1, &textureAlbedo);
+    glBindTexture(GL_TEXTURE_2D, textureAlbedo);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, textureAlbedo, 0);
+
+    const GLenum drawBuffers[4] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+    glDrawBuffers(4, drawBuffers);
+
     // Добавляем буфер глубины
     unsigned int rbo;
     glGenRenderbuffers(1, &rbo);
@@ -30,4 +55,10 @@ Framebuffer::Framebuffer(int width, int height) : width(width), height(height) {
 
 void Framebuffer::bind() { glBindFramebuffer(GL_FRAMEBUFFER, fbo); }
 void Framebuffer::unbind() { glBindFramebuffer(GL_FRAMEBUFFER, 0); }
-Framebuffer::~Framebuffer() { glDeleteFramebuffers(1, &fbo); }
\ No newline at end of file
+Framebuffer::~Framebuffer() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &textureColor);
+    glDeleteTextures(1, &textureMoments);
+    glDeleteTextures(1, &textureGBuffer);
+    glDeleteTextures(1, &textureAlbedo);
+}
\ No newline at end of file
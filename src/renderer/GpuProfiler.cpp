@@ -0,0 +1,161 @@
+#include "GpuProfiler.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+GpuProfiler::GpuProfiler() {
+    for (FrameSlot& f : frames) {
+        for (Scope& s : f.scopes) glGenQueries(2, s.queries);
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (FrameSlot& f : frames) {
+        for (Scope& s : f.scopes) glDeleteQueries(2, s.queries);
+    }
+}
+
+int GpuProfiler::findPass(const char* name) {
+    for (size_t i = 0; i < passList.size(); i++) {
+        if (passList[i].name == name) return (int)i;
+    }
+    Pass p;
+    p.name = name;
+    passList.push_back(p);
+    return (int)passList.size() - 1;
+}
+
+float GpuProfiler::passMs(const char* name) const {
+    for (const Pass& p : passList) {
+        if (p.name == name) return p.avgMs;
+    }
+    return 0.0f;
+}
+
+void GpuProfiler::collect() {
+    // От старого кадра к новому: история должна идти по порядку
+    for (int i = kFrames; i > 0; i--) {
+        FrameSlot& f = frames[(frameCounter - i + kFrames * 2) % kFrames];
+        if (!f.pending) continue;
+
+        // Метки выполняются по порядку: готова последняя - готовы все
+        GLint available = 0;
+        glGetQueryObjectiv(f.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        std::vector<float> ms(passList.size(), 0.0f);
+        GLuint64 first = ~0ull, last = 0;
+        for (int s = 0; s < f.count; s++) {
+            GLuint64 t0 = 0, t1 = 0;
+            glGetQueryObjectui64v(f.scopes[s].queries[0], GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(f.scopes[s].queries[1], GL_QUERY_RESULT, &t1);
+            ms[f.scopes[s].pass] += (float)(t1 - t0) * 1e-6f;
+            first = std::min(first, t0);
+            last = std::max(last, t1);
+        }
+        f.pending = false;
+
+        int slot = historyPos % kHistory;
+        for (size_t p = 0; p < passList.size(); p++) {
+            passList[p].history[slot] = ms[p];
+            passList[p].avgMs = passList[p].avgMs * 0.9f + ms[p] * 0.1f;
+        }
+        float total = (float)(last - first) * 1e-6f;
+        frameHistory[slot] = total;
+        frameMs = frameMs * 0.9f + total * 0.1f;
+        historyPos++;
+    }
+}
+
+void GpuProfiler::beginFrame() {
+    collect();
+    active = nullptr;
+    openScopes.clear();
+    FrameSlot& f = frames[frameCounter++ % kFrames];
+    // GPU отстаёт больше чем на kFrames кадров - этот кадр не меряем
+    if (f.pending) return;
+    f.count = 0;
+    active = &f;
+}
+
+void GpuProfiler::endFrame() {
+    if (!active) return;
+    while (!openScopes.empty()) end();
+    active->pending = active->count > 0;
+    active = nullptr;
+}
+
+void GpuProfiler::begin(const char* name) {
+    if (!active || active->count >= kMaxScopes) {
+        openScopes.push_back(-1);
+        return;
+    }
+    Scope& s = active->scopes[active->count];
+    s.pass = findPass(name);
+    glQueryCounter(s.queries[0], GL_TIMESTAMP);
+    active->lastQuery = s.queries[0];
+    openScopes.push_back(active->count++);
+}
+
+void GpuProfiler::end() {
+    if (openScopes.empty()) return;
+    int scope = openScopes.back();
+    openScopes.pop_back();
+    if (!active || scope < 0) return;
+    glQueryCounter(active->scopes[scope].queries[1], GL_TIMESTAMP);
+    active->lastQuery = active->scopes[scope].queries[1];
+}
+
+bool GpuProfiler::exportCSV(const std::string& path) const {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        std::cout << "Profiler: cannot write " << path << std::endl;
+        return false;
+    }
+    file << "frame,gpu_frame_ms";
+    for (const Pass& p : passList) file << "," << p.name << "_ms";
+    file << "\n";
+
+    int count = std::min(historyPos, kHistory);
+    for (int i = historyPos - count; i < historyPos; i++) {
+        int slot = i % kHistory;
+        file << i << "," << frameHistory[slot];
+        for (const Pass& p : passList) file << "," << p.history[slot];
+        file << "\n";
+    }
+    std::cout << "Profiler: " << count << " frames -> " << path << std::endl;
+    return true;
+}
+
+void GpuProfiler::drawWindow(bool* open, float budgetMs) {
+    if (!ImGui::Begin("GPU Profiler", open)) {
+        ImGui::End();
+        return;
+    }
+
+    int offset = historyPos % kHistory;
+    float scaleMax = std::max(budgetMs * 1.5f, 1.0f);
+    char overlay[64];
+
+    snprintf(overlay, sizeof(overlay), "%.2f ms (budget %.2f)", frameMs, budgetMs);
+    ImGui::Text("GPU frame");
+    ImGui::PlotLines("##frame", frameHistory, kHistory, offset, overlay, 0.0f, scaleMax, ImVec2(-1, 60));
+
+    for (const Pass& p : passList) {
+        snprintf(overlay, sizeof(overlay), "%.2f ms", p.avgMs);
+        ImGui::Text("%s", p.name.c_str());
+        ImGui::PlotLines(("##" + p.name).c_str(), p.history, kHistory, offset, overlay, 0.0f, scaleMax, ImVec2(-1, 40));
+    }
+
+    ImGui::Separator();
+    if (ImGui::Button("Export CSV")) {
+        exportStatus = exportCSV("gpu_profile.csv") ? "Saved gpu_profile.csv" : "Export failed";
+    }
+    if (!exportStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s", exportStatus.c_str());
+    }
+    ImGui::End();
+}
@@ -1,10 +1,299 @@
 #include "LightSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
 
 namespace lightsys {
     GLuint lightSSBO = 0; 
+    GLuint lightTreeSSBO = 0;
     std::vector<GPULight> allLights;
+    std::vector<GPULightNode> lightTree;
 
     void AddLight(glm::vec3 pos, float rad, glm::vec3 power) {
     allLights.push_back({pos, rad, power, 0.0f});
     }
-}
\ No newline at end of file
+
+namespace {
+
+// Мощность в тех же единицах, что и вклад в sampleLight: яркость излучения * площадь сферы
+float LightPower(const GPULight& l) {
+    float luminance = glm::dot(l.emission, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    return luminance * 4.0f * 3.14159265f * l.radius * l.radius;
+}
+
+void BuildNode(int nodeIdx, int* first, int count) {
+    GPULightNode& node = lightTree[nodeIdx];
+    node.minBounds = glm::vec3(1e30f);
+    node.maxBounds = glm::vec3(-1e30f);
+    node.power = 0.0f;
+    glm::vec3 cMin(1e30f), cMax(-1e30f);
+    for (int i = 0; i < count; i++) {
+        const GPULight& l = allLights[first[i]];
+        node.minBounds = glm::min(node.minBounds, l.position - glm::vec3(l.radius));
+        node.maxBounds = glm::max(node.maxBounds, l.position + glm::vec3(l.radius));
+        node.power += LightPower(l);
+        cMin = glm::min(cMin, l.position);
+        cMax = glm::max(cMax, l.position);
+    }
+
+    if (count == 1) {
+        node.child = ~first[0];
+        return;
+    }
+
+    glm::vec3 extent = cMax - cMin;
+    int axis = 0;
+    if (extent.y > extent.x) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+
+    int half = count / 2;
+    std::nth_element(first, first + half, first + count, [axis](int a, int b) {
+        return allLights[a].position[axis] < allLights[b].position[axis];
+    });
+
+    int left = (int)lightTree.size();
+    lightTree.push_back({});
+    lightTree.push_back({});
+    lightTree[nodeIdx].child = left; // node мог переехать при push_back
+    BuildNode(left, first, half);
+    BuildNode(left + 1, first + half, count - half);
+}
+
+} // namespace
+
+    void BuildLightTree() {
+        lightTree.clear();
+        if (allLights.empty()) return;
+        std::vector<int> order(allLights.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+        lightTree.reserve(2 * allLights.size());
+        lightTree.push_back({});
+        BuildNode(0, order.data(), (int)order.size());
+    }
+
+    void RefitLightTree() {
+        // Дети всегда лежат после родителя, поэтому хватает одного прохода с конца
+        for (int i = (int)lightTree.size() - 1; i >= 0; i--) {
+            GPULightNode& node = lightTree[i];
+            if (node.child < 0) {
+                const GPULight& l = allLights[~node.child];
+                node.minBounds = l.position - glm::vec3(l.radius);
+                node.maxBounds = l.position + glm::vec3(l.radius);
+                node.power = LightPower(l);
+            } else {
+                const GPULightNode& a = lightTree[node.child];
+                const GPULightNode& b = lightTree[node.child + 1];
+                node.minBounds = glm::min(a.minBounds, b.minBounds);
+                node.maxBounds = glm::max(a.maxBounds, b.maxBounds);
+                node.power = a.power + b.power;
+            }
+        }
+    }
+
+    void UploadLights() {
+        // В дереве из n листьев 2n - 1 узлов
+        if (lightTree.size() + 1 != 2 * allLights.size()) BuildLightTree();
+        else RefitLightTree();
+
+        // Размер меняется только при добавлении источников - тогда буфер пересоздаётся
+        auto upload = [](GLuint& buffer, GLuint binding, const void* data, GLsizeiptr size) {
+            GLint current = -1;
+            if (!buffer) glGenBuffers(1, &buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glGetBufferParameteriv(GL_SHADER_STORAGE_BUFFER, GL_BUFFER_SIZE, &current);
+            if (current != (GLint)size) glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+            else glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+        };
+        upload(lightSSBO, 5, allLights.data(), allLights.size() * sizeof(GPULight));
+        upload(lightTreeSSBO, 18, lightTree.data(), lightTree.size() * sizeof(GPULightNode));
+    }
+
+    float LightNodeImportance(const GPULightNode& node, const glm::vec3& p, const glm::vec3& n) {
+        glm::vec3 center = (node.minBounds + node.maxBounds) * 0.5f;
+        float r = glm::length(node.maxBounds - node.minBounds) * 0.5f;
+        glm::vec3 d = center - p;
+        float dist2 = glm::dot(d, d);
+        float dist = std::sqrt(dist2);
+
+        // Косинус угла к нормали, уменьшенный на угловой радиус сферы вокруг узла
+        float cosBound = 1.0f;
+        if (dist > r) {
+            float cosTheta = glm::dot(n, d) / dist;
+            float sinAlpha = r / dist;
+            float cosAlpha = std::sqrt(1.0f - sinAlpha * sinAlpha);
+            if (cosTheta < cosAlpha) {
+                float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+                cosBound = cosTheta * cosAlpha + sinTheta * sinAlpha;
+            }
+        }
+        if (cosBound <= 0.0f) return 0.0f;
+        return node.power * cosBound / std::max(dist2, r * r);
+    }
+
+    int SampleLightTree(const glm::vec3& p, const glm::vec3& n, PathSampler& sampler, float& pdf) {
+        pdf = 1.0f;
+        if (lightTree.empty()) return -1;
+        int nodeIdx = 0;
+        while (lightTree[nodeIdx].child >= 0) {
+            int left = lightTree[nodeIdx].child;
+            float il = LightNodeImportance(lightTree[left], p, n);
+            float ir = LightNodeImportance(lightTree[left + 1], p, n);
+            if (il + ir <= 0.0f) return -1;
+            float pl = il / (il + ir);
+            if (sampler.next() < pl) {
+                nodeIdx = left;
+                pdf *= pl;
+            } else {
+                nodeIdx = left + 1;
+                pdf *= 1.0f - pl;
+            }
+        }
+        return ~lightTree[nodeIdx].child;
+    }
+
+    void LightTreePdfs(const glm::vec3& p, const glm::vec3& n, std::vector<float>& pdfs) {
+        pdfs.assign(allLights.size(), 0.0f);
+        if (lightTree.empty()) return;
+        // Те же умножения, что и при спуске в SampleLightTree, только по всем веткам сразу
+        std::vector<std::pair<int, float>> stack = { { 0, 1.0f } };
+        while (!stack.empty()) {
+            auto [nodeIdx, pdf] = stack.back();
+            stack.pop_back();
+            const GPULightNode& node = lightTree[nodeIdx];
+            if (node.child < 0) {
+                pdfs[~node.child] = pdf;
+                continue;
+            }
+            float il = LightNodeImportance(lightTree[node.child], p, n);
+            float ir = LightNodeImportance(lightTree[node.child + 1], p, n);
+            if (il + ir <= 0.0f) continue;
+            float pl = il / (il + ir);
+            if (pl > 0.0f) stack.push_back({ node.child, pdf * pl });
+            if (pl < 1.0f) stack.push_back({ node.child + 1, pdf * (1.0f - pl) });
+        }
+    }
+
+namespace {
+
+// Вклад источника без видимости, как lightContribution в шейдере для точечного источника в центре:
+// мощность * косинус / расстояние^2. Точный ответ для оценки - сумма по всем источникам
+float LightContribution(const GPULight& l, const glm::vec3& p, const glm::vec3& n) {
+    glm::vec3 d = l.position - p;
+    float dist2 = std::max(glm::dot(d, d), l.radius * l.radius);
+    float cosTheta = glm::dot(n, d) / std::sqrt(dist2);
+    return cosTheta > 0.0f ? LightPower(l) * cosTheta / dist2 : 0.0f;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+    bool RunLightTreeBenchmark() {
+        const std::vector<int> lightCounts = { 3, 100, 1000, 10000, 100000 };
+        const int points = 256;
+        const int samplesPerPoint = 64;
+
+        std::vector<GPULight> savedLights = allLights;
+        std::vector<GPULightNode> savedTree = lightTree;
+        bool ok = true;
+
+        std::cout << "Light tree vs uniform light picking: " << points << " shading points, "
+                  << samplesPerPoint << " samples each, relative RMSE of unshadowed irradiance" << std::endl;
+        std::cout << std::right << std::setw(8) << "lights" << std::setw(10) << "build ms" << std::setw(10) << "refit ms"
+                  << std::setw(10) << "pdf err" << std::setw(8) << "bias" << std::setw(8) << "lost" << std::setw(12) << "RMSE tree" << std::setw(12) << "RMSE unif"
+                  << std::setw(12) << "ns tree" << std::setw(12) << "ns unif" << std::endl;
+
+        for (int count : lightCounts) {
+            std::mt19937 rng(1234 + count);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            auto inBox = [&]() { return glm::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f - glm::vec3(50.0f); };
+
+            allLights.clear();
+            for (int i = 0; i < count; i++) {
+                AddLight(inBox(), 0.05f + 0.25f * unit(rng), glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f);
+            }
+            auto start = std::chrono::steady_clock::now();
+            BuildLightTree();
+            double buildMs = SecondsSince(start) * 1000.0;
+            start = std::chrono::steady_clock::now();
+            RefitLightTree();
+            double refitMs = SecondsSince(start) * 1000.0;
+
+            // Сумма pdf меньше единицы, когда оба ребёнка важного узла целиком под горизонтом: спуск
+            // там обрывается с -1. Смещения это не даёт (вклад таких источников нулевой), только пустые выборки
+            float maxPdfError = 0.0f; // Превышение суммы pdf над 1 и расхождение pdf выбранного с LightTreePdfs
+            double lostMass = 0.0;    // Доля пустых выборок
+            int biasViolations = 0;   // Источники с вкладом, но нулевой вероятностью
+            double sqErrorTree = 0.0, sqErrorUniform = 0.0;
+            double secondsTree = 0.0, secondsUniform = 0.0;
+            std::vector<float> pdfs;
+
+            for (int pt = 0; pt < points; pt++) {
+                glm::vec3 p = inBox();
+                glm::vec3 n = glm::normalize(inBox() + glm::vec3(1e-3f));
+
+                double exact = 0.0;
+                float pdfSum = 0.0f;
+                LightTreePdfs(p, n, pdfs);
+                for (int i = 0; i < count; i++) {
+                    float f = LightContribution(allLights[i], p, n);
+                    exact += f;
+                    pdfSum += pdfs[i];
+                    if (f > 0.0f && pdfs[i] <= 0.0f) biasViolations++;
+                }
+                maxPdfError = std::max(maxPdfError, pdfSum - 1.0f);
+                lostMass += 1.0 - std::min(pdfSum, 1.0f);
+                if (exact <= 0.0) continue;
+
+                SampleSeed seed;
+                seed.lcg = glm::vec2(unit(rng), unit(rng));
+                PathSampler sampler(SAMPLER_LCG, pt, 0, seed);
+
+                double tree = 0.0;
+                start = std::chrono::steady_clock::now();
+                for (int s = 0; s < samplesPerPoint; s++) {
+                    float pdf;
+                    int i = SampleLightTree(p, n, sampler, pdf);
+                    if (i < 0) continue;
+                    tree += LightContribution(allLights[i], p, n) / pdf;
+                    maxPdfError = std::max(maxPdfError, std::abs(pdf - pdfs[i]) / pdfs[i]);
+                }
+                secondsTree += SecondsSince(start);
+
+                double uniform = 0.0;
+                start = std::chrono::steady_clock::now();
+                for (int s = 0; s < samplesPerPoint; s++) {
+                    int i = std::min((int)(sampler.next() * count), count - 1);
+                    uniform += LightContribution(allLights[i], p, n) * count;
+                }
+                secondsUniform += SecondsSince(start);
+
+                double errTree = tree / samplesPerPoint / exact - 1.0;
+                double errUniform = uniform / samplesPerPoint / exact - 1.0;
+                sqErrorTree += errTree * errTree;
+                sqErrorUniform += errUniform * errUniform;
+            }
+
+            bool passed = maxPdfError < 1e-3f && biasViolations == 0;
+            ok = ok && passed;
+            double samples = (double)points * samplesPerPoint;
+            std::cout << std::setw(8) << count << std::fixed << std::setprecision(3) << std::setw(10) << buildMs << std::setw(10) << refitMs
+                      << std::scientific << std::setprecision(1) << std::setw(10) << maxPdfError << std::setw(8) << biasViolations
+                      << std::fixed << std::setprecision(3) << std::setw(8) << lostMass / points
+                      << std::fixed << std::setprecision(4) << std::setw(12) << std::sqrt(sqErrorTree / points)
+                      << std::setw(12) << std::sqrt(sqErrorUniform / points)
+                      << std::setprecision(1) << std::setw(12) << secondsTree / samples * 1e9 << std::setw(12) << secondsUniform / samples * 1e9
+                      << std::defaultfloat << (passed ? "" : "  FAIL") << std::endl;
+        }
+
+        allLights = savedLights;
+        lightTree = savedTree;
+        return ok;
+    }
+}
@@ -0,0 +1,85 @@
+#include "SampleScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const double kSmoothing = 0.2;            // Вес свежего замера
+const GLuint64 kFenceTimeout = 100000000; // 100 мс: дольше ждать - значит, что-то сломалось, идём дальше
+
+} // namespace
+
+SampleScheduler::SampleScheduler() {
+    for (Slot& s : slots) glGenQueries(1, &s.query);
+}
+
+SampleScheduler::~SampleScheduler() {
+    for (Slot& s : slots) glDeleteQueries(1, &s.query);
+    for (GLsync f : fences) glDeleteSync(f);
+}
+
+void SampleScheduler::beginFrame() {
+    // Ограничиваем кадры в полёте: старший фенс должен пройти, прежде чем начнём новый
+    auto waitStart = std::chrono::steady_clock::now();
+    while ((int)fences.size() >= std::max(maxFramesInFlight, 1)) {
+        glClientWaitSync(fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, kFenceTimeout);
+        glDeleteSync(fences.front());
+        fences.pop_front();
+    }
+    fenceWaitMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+    newMeasurement = false;
+    for (int i = kSlots; i > 0; i--) {
+        Slot& slot = slots[(frame - i + kSlots * 2) % kSlots];
+        if (!slot.pending) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(slot.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(slot.query, GL_QUERY_RESULT, &ns);
+        slot.pending = false;
+
+        // Цена на пиксель, чтобы смена разрешения не обнуляла историю
+        double perPixel = (double)ns * 1e-9 / ((double)slot.samples * (double)slot.pixels);
+        secondsPerPixelSample = secondsPerPixelSample < 0.0 ? perPixel : secondsPerPixelSample * (1.0 - kSmoothing) + perPixel * kSmoothing;
+        measuredSampleMs = (float)(perPixel * slot.pixels * 1000.0);
+        newMeasurement = true;
+    }
+}
+
+float SampleScheduler::sampleSeconds(int pixelCount) const {
+    if (secondsPerPixelSample < 0.0) return -1.0f;
+    return (float)(secondsPerPixelSample * pixelCount);
+}
+
+int SampleScheduler::plan(float budgetSeconds, int pixelCount, int maxSamples) {
+    float cost = sampleSeconds(pixelCount);
+    predictedSampleMs = std::max(cost, 0.0f) * 1000.0f;
+    // Пока замеров нет, по одному сэмплу: лучше недобрать кадр, чем сорваться в статтер
+    if (cost <= 0.0f) return 1;
+    int fit = (int)std::floor(budgetSeconds * budgetFraction / cost);
+    return std::clamp(fit, 1, std::max(maxSamples, 1));
+}
+
+void SampleScheduler::beginSamples(int pixelCount) {
+    active = nullptr;
+    Slot& slot = slots[frame++ % kSlots];
+    // Слот ещё не прочитан - GPU отстаёт на kSlots кадров, этот кадр не меряем
+    if (slot.pending) return;
+    glBeginQuery(GL_TIME_ELAPSED, slot.query);
+    slot.pixels = std::max(pixelCount, 1);
+    active = &slot;
+}
+
+void SampleScheduler::endSamples(int samples) {
+    if (!active) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    active->samples = samples;
+    active->pending = samples > 0;
+    active = nullptr;
+}
+
+void SampleScheduler::endFrame() {
+    fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
@@ -2,34 +2,419 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <thread>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-    std::string vCode, fCode;
-    std::ifstream vFile, fFile;
-    vFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        vFile.open(vertexPath); fFile.open(fragmentPath);
-        std::stringstream vStream, fStream;
-        vStream << vFile.rdbuf(); fStream << fFile.rdbuf();
-        vCode = vStream.str(); fCode = fStream.str();
-    } catch (std::ifstream::failure& e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_READ: " << e.what() << std::endl;
-    }
-    const char* vShaderCode = vCode.c_str();
-    const char* fShaderCode = fCode.c_str();
-
-    unsigned int v, f;
-    v = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(v, 1, &vShaderCode, NULL);
-    glCompileShader(v);
-
-    f = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(f, 1, &fShaderCode, NULL);
-    glCompileShader(f);
-
-    ID = glCreateProgram();
-    glAttachShader(ID, v); glAttachShader(ID, f);
-    glLinkProgram(ID);
-    glDeleteShader(v); glDeleteShader(f);
-}
\ No newline at end of file
+namespace {
+
+const char* kShaderCacheDir = "cache/shaders";
+const uint32_t kShaderCacheMagic = 0x50524743; // "CGRP"
+
+bool ReadFile(const std::string& path, std::string& out) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    out = stream.str();
+    return true;
+}
+
+long long FileWriteTime(const std::string& path) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : (long long)t.time_since_epoch().count();
+}
+
+uint64_t HashAppend(uint64_t h, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) { h ^= (unsigned char)data[i]; h *= 1099511628211ull; }
+    return h;
+}
+
+// Ключ кэша: исходники + драйвер. Бинарник от другой версии драйвера всё равно не загрузится
+uint64_t ProgramHash(const std::vector<std::string>& codes) {
+    uint64_t h = 1469598103934665603ull;
+    for (GLenum e : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+        const char* s = (const char*)glGetString(e);
+        if (s) h = HashAppend(h, s, std::strlen(s));
+    }
+    for (const std::string& code : codes) {
+        h = HashAppend(h, code.data(), code.size());
+        h = HashAppend(h, "\0", 1);
+    }
+    return h;
+}
+
+std::string ProgramCachePath(uint64_t hash) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return std::string(kShaderCacheDir) + "/" + name;
+}
+
+bool BinaryCacheSupported() {
+    if (!GLAD_GL_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+bool ParallelCompileSupported() {
+    return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+}
+
+// Заголовок файла кэша: magic, формат бинарника, размер
+GLuint LoadProgramBinary(uint64_t hash) {
+    if (!BinaryCacheSupported()) return 0;
+    std::string bytes;
+    if (!ReadFile(ProgramCachePath(hash), bytes) || bytes.size() < 12) return 0;
+
+    uint32_t magic, format, size;
+    std::memcpy(&magic, bytes.data(), 4);
+    std::memcpy(&format, bytes.data() + 4, 4);
+    std::memcpy(&size, bytes.data() + 8, 4);
+    if (magic != kShaderCacheMagic || size != bytes.size() - 12) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, (GLenum)format, bytes.data() + 12, (GLsizei)size);
+    GLint ok = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void SaveProgramBinary(GLuint program, uint64_t hash) {
+    if (!BinaryCacheSupported()) return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> bytes(12 + (size_t)length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, bytes.data() + 12);
+    if (written <= 0) return;
+
+    uint32_t header[3] = { kShaderCacheMagic, (uint32_t)format, (uint32_t)written };
+    std::memcpy(bytes.data(), header, 12);
+
+    // Через временный файл и rename, как в TextureCache: оборванная запись (или второй экземпляр
+    // программы, пишущий тот же ключ) не оставит в кэше обрезанный бинарник
+    std::error_code ec;
+    std::filesystem::create_directories(kShaderCacheDir, ec);
+    std::string path = ProgramCachePath(hash);
+    std::string tmpPath = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    bool ok = false;
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        ok = file && file.write(bytes.data(), 12 + (std::streamsize)written);
+    }
+    if (ok) std::filesystem::rename(tmpPath, path, ec);
+    if (!ok || ec) std::filesystem::remove(tmpPath, ec);
+}
+
+// Раскрывает #include "file" (путь относительно текущего файла). Каждый файл подключается один раз,
+// номер в files идёт вторым аргументом #line - по нему ошибку в логе драйвера можно найти в нужном файле
+bool ExpandIncludes(const std::string& path, std::string& out, std::vector<std::string>& files, int depth) {
+    std::string code;
+    if (depth > 16 || !ReadFile(path, code)) {
+        std::cout << "ERROR::SHADER::FILE_NOT_READ: " << path << std::endl;
+        return false;
+    }
+    int fileIndex = (int)files.size();
+    files.push_back(path);
+    std::string dir = std::filesystem::path(path).parent_path().string();
+
+    std::istringstream lines(code);
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+
+        size_t open = line.find('"', start), close = line.rfind('"');
+        if (open == std::string::npos || close <= open) {
+            std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << ":" << lineNumber << std::endl;
+            return false;
+        }
+        std::string included = (std::filesystem::path(dir) / line.substr(open + 1, close - open - 1)).lexically_normal().string();
+        if (std::find(files.begin(), files.end(), included) == files.end()) {
+            out += "#line 1 " + std::to_string(files.size()) + "\n";
+            if (!ExpandIncludes(included, out, files, depth + 1)) return false;
+        }
+        out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+    }
+    return true;
+}
+
+// #define после строки #version, затем #line, чтобы номера строк в логах совпадали с файлом
+std::string InjectDefines(const std::string& code, const std::vector<std::string>& defines) {
+    if (defines.empty()) return code;
+    size_t versionPos = code.find("#version");
+    size_t insertPos = versionPos == std::string::npos ? 0 : code.find('\n', versionPos);
+    if (insertPos == std::string::npos) insertPos = code.size();
+    else if (versionPos != std::string::npos) insertPos++;
+
+    int versionLine = 1;
+    for (size_t i = 0; i < insertPos; i++) if (code[i] == '\n') versionLine++;
+
+    std::string block;
+    for (const std::string& d : defines) block += "#define " + d + "\n";
+    block += "#line " + std::to_string(versionLine) + "\n";
+    return code.substr(0, insertPos) + block + code.substr(insertPos);
+}
+
+// Шейдеры читаем из дерева исходников (POSTFRAME_SOURCE_DIR задаёт CMake): копия assets в папке сборки
+// обновляется только при сборке, и горячая перезагрузка по правке в репозитории её бы не заметила.
+// Если исходников нет (бинарник перенесли) - путь как есть, относительно рабочей папки
+std::string SourcePath(const char* path) {
+#ifdef POSTFRAME_SOURCE_DIR
+    std::filesystem::path source = std::filesystem::path(POSTFRAME_SOURCE_DIR) / path;
+    std::error_code ec;
+    if (std::filesystem::exists(source, ec)) return source.lexically_normal().string();
+#endif
+    return path;
+}
+
+void PrintShaderLog(GLuint shader, const std::string& path) {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(shader, (GLsizei)log.size(), nullptr, &log[0]);
+    std::cout << "ERROR::SHADER::COMPILATION_FAILED (" << path << ")\n" << log.c_str() << std::endl;
+}
+
+} // namespace
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+    : stages{ { GL_VERTEX_SHADER, SourcePath(vertexPath) }, { GL_FRAGMENT_SHADER, SourcePath(fragmentPath) } }, defines(defines) {
+    init();
+}
+
+Shader::Shader(const char* computePath, const std::vector<std::string>& defines)
+    : stages{ { GL_COMPUTE_SHADER, SourcePath(computePath) } }, defines(defines) {
+    init();
+}
+
+void Shader::init() {
+    // Разрешаем драйверу компилировать в своих потоках (сколько сочтёт нужным)
+    static bool threadsConfigured = false;
+    if (!threadsConfigured) {
+        threadsConfigured = true;
+        if (GLAD_GL_KHR_parallel_shader_compile) glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        else if (GLAD_GL_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+    }
+
+    lastWatchCheck = std::chrono::steady_clock::now();
+
+    std::vector<std::string> codes;
+    if (!readSources(codes)) return;
+
+    // Сборка стартует здесь, а ждём её только в первом use() - несколько шейдеров компилируются параллельно
+    initial = startBuild(codes);
+}
+
+Shader::~Shader() {
+    discardBuild(initial);
+    discardBuild(reloading);
+    if (ID) glDeleteProgram(ID);
+}
+
+bool Shader::readSources(std::vector<std::string>& codes) {
+    codes.clear();
+    for (const Stage& stage : stages) {
+        std::string code;
+        std::vector<std::string> files;
+        if (!ExpandIncludes(stage.path, code, files, 0)) return false;
+        codes.push_back(InjectDefines(code, defines));
+
+        // Подключённые файлы тоже отслеживаем - правка общего кода перезагружает все программы с ним
+        for (const std::string& f : files) {
+            auto it = std::find_if(watchedFiles.begin(), watchedFiles.end(), [&](const WatchedFile& w) { return w.path == f; });
+            if (it == watchedFiles.end()) watchedFiles.push_back({ f, FileWriteTime(f) });
+        }
+    }
+    return true;
+}
+
+Shader::Build Shader::startBuild(const std::vector<std::string>& codes) {
+    Build b;
+    b.hash = ProgramHash(codes);
+
+    b.program = LoadProgramBinary(b.hash);
+    if (b.program) {
+        b.fromBinary = true;
+        return b;
+    }
+
+    b.program = glCreateProgram();
+    for (size_t i = 0; i < stages.size(); i++) {
+        const char* code = codes[i].c_str();
+        GLuint shader = glCreateShader(stages[i].type);
+        glShaderSource(shader, 1, &code, NULL);
+        glCompileShader(shader);
+        glAttachShader(b.program, shader);
+        b.shaders.push_back(shader);
+    }
+    if (BinaryCacheSupported()) glProgramParameteri(b.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(b.program);
+    return b;
+}
+
+bool Shader::isBuildDone(const Build& b) const {
+    if (!b.program || b.fromBinary || !ParallelCompileSupported()) return true;
+    GLint done = GL_FALSE;
+    glGetProgramiv(b.program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+bool Shader::finishBuild(Build& b) {
+    if (!b.program) return false;
+    if (b.fromBinary) return true;
+
+    GLint ok = 0;
+    glGetProgramiv(b.program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        for (size_t i = 0; i < b.shaders.size(); i++) {
+            GLint compiled = 0;
+            glGetShaderiv(b.shaders[i], GL_COMPILE_STATUS, &compiled);
+            if (!compiled) PrintShaderLog(b.shaders[i], stages[i].path);
+        }
+
+        GLint length = 0;
+        glGetProgramiv(b.program, GL_INFO_LOG_LENGTH, &length);
+        std::string log(std::max(length, 1), '\0');
+        glGetProgramInfoLog(b.program, (GLsizei)log.size(), nullptr, &log[0]);
+        std::cout << "ERROR::SHADER::LINKING_FAILED (" << stages.back().path << ")\n" << log.c_str() << std::endl;
+        discardBuild(b);
+        return false;
+    }
+
+    for (GLuint shader : b.shaders) {
+        glDetachShader(b.program, shader);
+        glDeleteShader(shader);
+    }
+    b.shaders.clear();
+    SaveProgramBinary(b.program, b.hash);
+    return true;
+}
+
+void Shader::discardBuild(Build& b) {
+    for (GLuint shader : b.shaders) glDeleteShader(shader);
+    if (b.program) glDeleteProgram(b.program);
+    b = Build();
+}
+
+void Shader::waitForInitialBuild() {
+    if (!initial.program) return;
+    // GL_LINK_STATUS сам дождётся окончания компиляции
+    if (finishBuild(initial)) {
+        ID = initial.program;
+        initial = Build();
+        cacheUniformLocations();
+    }
+}
+
+bool Shader::isReady() {
+    if (ID) return true;
+    if (!initial.program || !isBuildDone(initial)) return false;
+    waitForInitialBuild();
+    return ID != 0;
+}
+
+bool Shader::pollReload() {
+    // Идущая сборка: проверяем без блокировки, подменяем только готовую и успешную
+    if (reloading.program) {
+        if (!isBuildDone(reloading)) return false;
+        if (!finishBuild(reloading)) return false;
+
+        if (ID) glDeleteProgram(ID);
+        ID = reloading.program;
+        reloading = Build();
+        cacheUniformLocations();
+        std::cout << "Shader reloaded: " << stages.back().path << std::endl;
+        return true;
+    }
+
+    // mtime проверяем не чаще 4 раз в секунду
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastWatchCheck < std::chrono::milliseconds(250)) return false;
+    lastWatchCheck = now;
+
+    bool changed = false;
+    for (WatchedFile& w : watchedFiles) {
+        long long t = FileWriteTime(w.path);
+        if (t != 0 && t != w.writeTime) {
+            w.writeTime = t;
+            changed = true;
+        }
+    }
+    if (!changed) return false;
+
+    std::vector<std::string> codes;
+    if (!readSources(codes)) return false;
+    reloading = startBuild(codes);
+    return false;
+}
+
+void Shader::cacheUniformLocations() {
+    uniformLocations.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(std::max(maxLength, 1), '\0');
+
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0; GLint size = 0; GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        std::string_view uniformName(name.data(), (size_t)length);
+
+        // Члены uniform-блоков живут в буфере, локации у них нет
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        if (loc < 0) continue;
+
+        auto cache = [&](std::string_view cachedName, GLint cachedLoc) {
+            auto inserted = uniformLocations.emplace(HashName(cachedName), cachedLoc);
+            if (!inserted.second && inserted.first->second != cachedLoc) {
+                std::cout << "WARNING::SHADER::UNIFORM_HASH_COLLISION: " << cachedName << std::endl;
+            }
+        };
+
+        // Массивы драйвер отдаёт одной записью "name[0]" с size элементов. Кладём под "name", "name[0]"
+        // и каждым "name[i]"; локации элементов спрашиваем у драйвера - подряд они идти не обязаны
+        if (uniformName.size() > 3 && uniformName.substr(uniformName.size() - 3) == "[0]") {
+            std::string base(uniformName.substr(0, uniformName.size() - 3));
+            cache(base, loc);
+            cache(uniformName, loc);
+            for (GLint e = 1; e < size; e++) {
+                std::string element = base + "[" + std::to_string(e) + "]";
+                GLint elementLoc = glGetUniformLocation(ID, element.c_str());
+                if (elementLoc >= 0) cache(element, elementLoc);
+            }
+            continue;
+        }
+        cache(uniformName, loc);
+    }
+}
+
+GLint Shader::lookupLocation(std::string_view name, bool warn) const {
+    if (!ID) return -1;
+    std::string key(name);
+    GLint loc = glGetUniformLocation(ID, key.c_str());
+    // Кэшируем и промах: предупреждение и поход в драйвер - один раз на имя
+    uniformLocations.emplace(HashName(name), loc);
+    if (loc < 0 && warn) {
+        std::cout << "WARNING::SHADER::UNKNOWN_UNIFORM: " << key << " (" << stages.back().path << ")" << std::endl;
+    }
+    return loc;
+}
@@ -1,5 +1,5 @@
 #include "Texture.h"
-#include "stb_image.h"
+#include "TextureCache.h"
 #include <iostream>
 
 Texture::Texture(const char* path, bool alpha) {
@@ -11,15 +11,21 @@ Texture::Texture(const char* path, bool alpha) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int w, h, ch;
-    stbi_set_flip_vertically_on_load(true);
-    unsigned char* data = stbi_load(path, &w, &h, &ch, alpha ? 4 : 3);
-    if (data) {
-        GLenum format = alpha ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
+    // Мип-цепочка берётся из дискового кэша (или строится на CPU и кладётся в него), glGenerateMipmap не нужен
+    CachedTexture tex;
+    if (!LoadTextureCached(path, alpha, tex)) {
         std::cout << "Failed to load texture: " << path << std::endl;
+        return;
     }
-    stbi_image_free(data);
-}
\ No newline at end of file
+
+    const CachedTextureHeader& h = tex.header();
+    glTexStorage2D(GL_TEXTURE_2D, tex.levels(), tex.internalFormat(), (GLsizei)h.width, (GLsizei)h.height);
+    for (int i = 0; i < tex.levels(); i++) {
+        const CachedMipEntry& m = tex.level(i);
+        if (tex.compressed()) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, m.width, m.height, tex.internalFormat(), (GLsizei)m.size, tex.levelData(i));
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, m.width, m.height, GL_RGBA, GL_UNSIGNED_BYTE, tex.levelData(i));
+        }
+    }
+}
@@ -0,0 +1,239 @@
+#include "TextureManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+
+TextureManager::TextureManager(int workerCount) {
+    createPlaceholder();
+    createStaging();
+
+    if (workerCount <= 0) {
+        int hw = (int)std::thread::hardware_concurrency();
+        workerCount = std::max(1, std::min(4, hw - 1));
+    }
+    for (int i = 0; i < workerCount; i++) {
+        workers.emplace_back(&TextureManager::workerLoop, this);
+    }
+}
+
+TextureManager::~TextureManager() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCv.notify_all();
+    for (std::thread& t : workers) t.join();
+
+    for (auto& e : entries) {
+        if (e->id) glDeleteTextures(1, &e->id);
+    }
+    for (GLsync& f : slotFences) {
+        if (f) glDeleteSync(f);
+    }
+    if (stagingPBO) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingPBO);
+        if (stagingPtr) glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &stagingPBO);
+    }
+    glDeleteTextures(1, &placeholder);
+}
+
+void TextureManager::createPlaceholder() {
+    const unsigned char grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &placeholder);
+    glBindTexture(GL_TEXTURE_2D, placeholder);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
+
+void TextureManager::createStaging() {
+    // Без ARB_buffer_storage остаёмся на обычном glTexSubImage2D из памяти процесса
+    if (!GLAD_GL_ARB_buffer_storage) return;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = (GLsizeiptr)(kStagingSlotSize * kStagingSlots);
+
+    glGenBuffers(1, &stagingPBO);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingPBO);
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+    stagingPtr = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags);
+    // PBO нельзя оставлять привязанным: иначе любой glTexImage2D (фреймбуферы, шрифты ImGui) прочитает из него
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!stagingPtr) {
+        std::cout << "TextureManager: persistent mapping failed, using direct uploads" << std::endl;
+        glDeleteBuffers(1, &stagingPBO);
+        stagingPBO = 0;
+    }
+}
+
+int TextureManager::request(const char* path, bool alpha) {
+    auto e = std::make_unique<Entry>();
+    e->path = path;
+    e->alpha = alpha;
+
+    int handle;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        handle = (int)entries.size();
+        entries.push_back(std::move(e));
+        decodeQueue.push_back(handle);
+    }
+    queueCv.notify_one();
+    return handle;
+}
+
+void TextureManager::workerLoop() {
+    while (true) {
+        Entry* e = nullptr;
+        int handle;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCv.wait(lock, [&] { return stopping || !decodeQueue.empty(); });
+            if (stopping) return;
+            handle = decodeQueue.front();
+            decodeQueue.pop_front();
+            e = entries[handle].get();
+        }
+
+        // Кэш отдаёт готовую мип-цепочку через mmap, при промахе декодирует и строит мипы сам.
+        // До попадания в decodedQueue запись принадлежит только этому потоку, пишем в неё без блокировки
+        if (!LoadTextureCached(e->path, e->alpha, e->data)) {
+            std::cout << "Failed to load texture: " << e->path << std::endl;
+            e->state = State::Failed;
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        e->state = State::Decoded;
+        decodedQueue.push_back(handle);
+    }
+}
+
+bool TextureManager::uploadLevel(Entry& e, int level, size_t& slotOffset) {
+    const CachedMipEntry& mip = e.data.level(level);
+    const size_t bytes = (size_t)mip.size;
+
+    auto submit = [&](const void* pixels) {
+        if (e.data.compressed()) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mip.width, mip.height, e.data.internalFormat(), (GLsizei)bytes, pixels);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+    };
+
+    glBindTexture(GL_TEXTURE_2D, e.id);
+    if (stagingPtr && slotOffset + bytes <= kStagingSlotSize) {
+        size_t offset = (size_t)currentSlot * kStagingSlotSize + slotOffset;
+        std::memcpy(stagingPtr + offset, e.data.levelData(level), bytes);
+        submit((const void*)(uintptr_t)offset);
+        // Выравниваем следующий уровень по 256 байт
+        slotOffset += (bytes + 255) & ~(size_t)255;
+        return true;
+    }
+
+    // Уровень не влез в слот - отдаём драйверу напрямую
+    if (stagingPtr) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    submit(e.data.levelData(level));
+    if (stagingPtr) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingPBO);
+    return false;
+}
+
+int TextureManager::update() {
+    // 1. Забираем свежедекодированные текстуры и выделяем под них хранилище
+    std::vector<int> fresh;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        fresh.swap(decodedQueue);
+    }
+    for (int handle : fresh) {
+        Entry& e = *entries[handle];
+        int levels = e.data.levels();
+
+        glGenTextures(1, &e.id);
+        glBindTexture(GL_TEXTURE_2D, e.id);
+        glTexStorage2D(GL_TEXTURE_2D, levels, e.data.internalFormat(), (GLsizei)e.data.header().width, (GLsizei)e.data.header().height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        e.nextLevel = levels - 1;
+        e.state = State::Uploading;
+        uploading.push_back(handle);
+    }
+    if (uploading.empty()) return 0;
+
+    // 2. Ждём, пока GPU дочитает слот, который мы заполняли kStagingSlots кадров назад
+    if (stagingPtr) {
+        GLsync& fence = slotFences[currentSlot];
+        if (fence) {
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingPBO);
+    }
+
+    // 3. Заливаем от маленьких уровней к большим, пока не кончится бюджет кадра
+    int becameResident = 0;
+    int mipsLeft = maxMipsPerFrame;
+    size_t bytesUsed = 0;
+    size_t slotOffset = 0;
+    bool usedSlot = false;
+
+    for (int handle : uploading) {
+        Entry& e = *entries[handle];
+        while (e.nextLevel >= 0 && mipsLeft > 0) {
+            size_t bytes = (size_t)e.data.level(e.nextLevel).size;
+            if (bytesUsed > 0 && bytesUsed + bytes > maxBytesPerFrame) break;
+            usedSlot |= uploadLevel(e, e.nextLevel, slotOffset);
+            bytesUsed += bytes;
+            mipsLeft--;
+            e.nextLevel--;
+        }
+        if (e.nextLevel < 0) {
+            e.data.close();
+            e.state = State::Resident;
+            becameResident++;
+        }
+        if (mipsLeft == 0 || bytesUsed >= maxBytesPerFrame) break;
+    }
+
+    if (stagingPtr) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (usedSlot) {
+            slotFences[currentSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            currentSlot = (currentSlot + 1) % kStagingSlots;
+        }
+    }
+
+    uploading.erase(std::remove_if(uploading.begin(), uploading.end(),
+        [&](int handle) { return entries[handle]->state == State::Resident; }), uploading.end());
+    return becameResident;
+}
+
+unsigned int TextureManager::getID(int handle) const {
+    if (handle < 0 || handle >= (int)entries.size()) return placeholder;
+    const Entry& e = *entries[handle];
+    return e.state == State::Resident ? e.id : placeholder;
+}
+
+bool TextureManager::isResident(int handle) const {
+    return handle >= 0 && handle < (int)entries.size() && entries[handle]->state == State::Resident;
+}
+
+int TextureManager::pendingCount() const {
+    int count = 0;
+    for (const auto& e : entries) {
+        State s = e->state;
+        if (s != State::Resident && s != State::Failed) count++;
+    }
+    return count;
+}
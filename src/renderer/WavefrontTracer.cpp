@@ -0,0 +1,293 @@
+#include "WavefrontTracer.h"
+#include "GPUMeshTriangle.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Размеры структур из pt_wf_common.glsl (std430)
+const GLsizeiptr kPathStateSize = 64;
+const GLsizeiptr kRayItemSize = 32;
+const GLsizeiptr kHitItemSize = 48;
+const GLsizeiptr kShadowItemSize = 48;
+const GLsizeiptr kReservoirSize = 64; // pt_wf_restir.glsl
+
+const int kQueueShadow = 2;
+const int kGroupSize = 64; // WF_GROUP_SIZE
+const int kTileSize = 8;   // generate/accumulate: 8x8
+
+GLuint CreateStorage(GLsizeiptr size) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+// Генератор случайных чисел (pt_sampler.glsl) есть во всех ядрах, которые зовут rand()
+void SetSampleSeed(Shader& kernel, const SampleSeed& seed) {
+    kernel.use();
+    kernel.setVec2("u_seed1", seed.lcg);
+    kernel.setInt("u_sampleIndex", seed.index);
+    kernel.setInt("u_samplerSeed", seed.scramble);
+}
+
+} // namespace
+
+const char* WavefrontTracer::KernelName(int kernel) {
+    static const char* names[KERNEL_COUNT] = { "generate", "extend", "restir", "shade", "shadow", "accumulate" };
+    return kernel >= 0 && kernel < KERNEL_COUNT ? names[kernel] : "?";
+}
+
+WavefrontTracer::WavefrontTracer()
+    : generate("assets/shaders/pt_wf_generate.glsl"),
+      extend("assets/shaders/pt_wf_extend.glsl"),
+      restirTemporal("assets/shaders/pt_wf_restir_temporal.glsl"),
+      restirSpatial("assets/shaders/pt_wf_restir_spatial.glsl"),
+      shade("assets/shaders/pt_wf_shade.glsl"),
+      shadow("assets/shaders/pt_wf_shadow.glsl"),
+      accumulate("assets/shaders/pt_wf_accumulate.glsl") {
+    counterBuffer = CreateStorage(3 * 4 * sizeof(GLuint));
+    for (TimerSlot& slot : timers) glGenQueries(kMaxTimestamps, slot.queries);
+}
+
+WavefrontTracer::~WavefrontTracer() {
+    GLuint buffers[] = { pathBuffer, rayBuffers[0], rayBuffers[1], hitBuffer, shadowBuffer, counterBuffer,
+                         reservoirBuffers[0], reservoirBuffers[1] };
+    for (GLuint b : buffers) if (b) glDeleteBuffers(1, &b);
+    for (TimerSlot& slot : timers) glDeleteQueries(kMaxTimestamps, slot.queries);
+}
+
+void WavefrontTracer::ensureCapacity(int pixelCount, int shadowCount) {
+    if (pixelCount > pathCapacity) {
+        GLuint old[] = { pathBuffer, rayBuffers[0], rayBuffers[1], hitBuffer, reservoirBuffers[0], reservoirBuffers[1] };
+        for (GLuint b : old) if (b) glDeleteBuffers(1, &b);
+
+        pathCapacity = pixelCount;
+        pathBuffer = CreateStorage(kPathStateSize * pathCapacity);
+        rayBuffers[0] = CreateStorage(kRayItemSize * pathCapacity);
+        rayBuffers[1] = CreateStorage(kRayItemSize * pathCapacity);
+        hitBuffer = CreateStorage(kHitItemSize * pathCapacity);
+        reservoirBuffers[0] = CreateStorage(kReservoirSize * pathCapacity);
+        reservoirBuffers[1] = CreateStorage(kReservoirSize * pathCapacity);
+        hasHistory = false;
+        std::cout << "Wavefront buffers: " << pathCapacity << " paths, "
+                  << (kPathStateSize + 2 * kRayItemSize + kHitItemSize + 2 * kReservoirSize) * pathCapacity / (1024 * 1024) << " MB" << std::endl;
+    }
+    if (shadowCount > shadowCapacity) {
+        if (shadowBuffer) glDeleteBuffers(1, &shadowBuffer);
+        shadowCapacity = shadowCount;
+        shadowBuffer = CreateStorage(kShadowItemSize * shadowCapacity);
+    }
+}
+
+// Очередь пуста: 0 групп (y = z = 1), длина 0
+void WavefrontTracer::resetQueue(int queue) {
+    const GLuint empty[4] = { 0, 1, 1, 0 };
+    glBufferSubData(GL_DISPATCH_INDIRECT_BUFFER, queue * sizeof(empty), sizeof(empty), empty);
+}
+
+// Аргументы запуска лежат в начале записи очереди в counterBuffer
+void WavefrontTracer::dispatchIndirect(int queue) {
+    glDispatchComputeIndirect((GLintptr)(queue * 4 * sizeof(GLuint)));
+}
+
+void WavefrontTracer::stamp(int nextKernel) {
+    if (!activeTimer || activeTimer->count >= kMaxTimestamps) return;
+    glQueryCounter(activeTimer->queries[activeTimer->count], GL_TIMESTAMP);
+    activeTimer->kernels[activeTimer->count] = nextKernel;
+    activeTimer->count++;
+}
+
+void WavefrontTracer::collectTimings() {
+    for (TimerSlot& slot : timers) {
+        if (!slot.pending) continue;
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+
+        double sums[KERNEL_COUNT] = {};
+        GLuint64 prev = 0;
+        for (int i = 0; i < slot.count; i++) {
+            GLuint64 t = 0;
+            glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &t);
+            if (i > 0) sums[slot.kernels[i - 1]] += (double)(t - prev) / 1e6;
+            prev = t;
+        }
+        for (int k = 0; k < KERNEL_COUNT; k++) kernelMs[k] = kernelMs[k] * 0.9f + (float)sums[k] * 0.1f;
+        slot.pending = false;
+    }
+}
+
+void WavefrontTracer::beginFrame() {
+    collectTimings();
+    timeNextSample = true;
+}
+
+void WavefrontTracer::traceSample(const SampleParams& params, const Framebuffer& prev, const Framebuffer& out) {
+    int width = params.width, height = params.height;
+    int pixelCount = width * height;
+    ensureCapacity(pixelCount, pixelCount * std::max(params.shadowRaysPerPath, 1));
+
+    // Резервуары адресуются по пикселю: при другом разрешении история бессмысленна
+    if (width != historyWidth || height != historyHeight) {
+        historyWidth = width;
+        historyHeight = height;
+        hasHistory = false;
+    }
+    bool useReSTIR = restir.enabled && params.bounces > 0;
+
+    if (!samplersSet) {
+        // Сэмплеры на тех же юнитах, что и в pt_fragment.glsl
+        // Текстуры сцены читает только extend (checkScene), остальным ядрам выставлять нечего
+        for (Shader* k : { &generate, &extend, &restirTemporal, &restirSpatial, &shade, &shadow, &accumulate }) {
+            k->use();
+            if (k->hasUniform("u_floorTex")) k->setInt("u_floorTex", 2);
+            for (int b = 0; b < MATERIAL_TEX_BUCKETS; b++) {
+                std::string name = "u_materialTex[" + std::to_string(b) + "]";
+                if (k->hasUniform(name)) k->setInt(name, MATERIAL_TEX_UNITS[b]);
+                else if (k == &extend) std::cout << "ERROR: " << name << " has no location in pt_wf_extend" << std::endl;
+            }
+        }
+        accumulate.setInt("u_sample", 0);
+        accumulate.setInt("u_moments", 4);
+        accumulate.setInt("u_prevGBuffer", 5);
+        accumulate.setInt("u_prevAlbedo", 6);
+        samplersSet = true;
+    }
+
+    // Замеряем один сэмпл за кадр, если есть свободный слот
+    activeTimer = nullptr;
+    if (timeNextSample) {
+        timeNextSample = false;
+        TimerSlot& slot = timers[timerFrame++ % kTimerSlots];
+        if (!slot.pending) {
+            slot.count = 0;
+            activeTimer = &slot;
+        }
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, pathBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 15, hitBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 16, shadowBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 17, counterBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 19, reservoirBuffers[0]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 20, reservoirBuffers[1]);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+
+    for (Shader* k : { &generate, &restirTemporal, &restirSpatial, &shade }) SetSampleSeed(*k, params.seed);
+
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    for (int q = 0; q < 3; q++) resetQueue(q);
+
+    GLuint groupsX = (GLuint)((width + kTileSize - 1) / kTileSize), groupsY = (GLuint)((height + kTileSize - 1) / kTileSize);
+
+    // Альбедо первичного попадания пишет extend на нулевом отскоке
+    glBindImageTexture(3, out.textureAlbedo, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    stamp(KERNEL_GENERATE);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, rayBuffers[0]);
+    generate.use();
+    generate.setInt("u_adaptive", params.adaptive ? 1 : 0);
+    glDispatchCompute(groupsX, groupsY, 1);
+
+    for (int bounce = 0; bounce < params.bounces; bounce++) {
+        int inQueue = bounce & 1, outQueue = 1 - inQueue;
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, rayBuffers[inQueue]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, rayBuffers[outQueue]);
+
+        // Выходная очередь - это входная прошлого отскока, её уже дочитали
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        resetQueue(outQueue);
+        resetQueue(kQueueShadow);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        stamp(KERNEL_EXTEND);
+        extend.use();
+        extend.setInt("u_inQueue", inQueue);
+        extend.setInt("u_bounce", bounce);
+        dispatchIndirect(inQueue);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        // Первичные попадания: кандидаты + история -> резервуар 19, соседи -> итоговый 20
+        if (bounce == 0 && useReSTIR) {
+            stamp(KERNEL_RESTIR);
+            restirTemporal.use();
+            restirTemporal.setInt("u_inQueue", inQueue);
+            restirTemporal.setMat4("u_prevView", prevView);
+            // Резервуары при смене разрешения сбрасываются, так что история всегда в текущем
+            restirTemporal.setVec2("u_prevResolution", glm::vec2((float)width, (float)height));
+            restirTemporal.setInt("u_hasHistory", hasHistory ? 1 : 0);
+            restirTemporal.setInt("u_candidates", std::max(restir.candidates, 1));
+            dispatchIndirect(inQueue);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            restirSpatial.use();
+            restirSpatial.setInt("u_adaptive", params.adaptive ? 1 : 0);
+            restirSpatial.setInt("u_neighbors", restir.neighbors);
+            restirSpatial.setFloat("u_radius", restir.radius);
+            glDispatchCompute(groupsX, groupsY, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        stamp(KERNEL_SHADE);
+        shade.use();
+        shade.setInt("u_inQueue", inQueue);
+        shade.setInt("u_bounce", bounce);
+        shade.setInt("u_restir", useReSTIR ? 1 : 0);
+        shade.setInt("u_shadowCapacity", shadowCapacity);
+        dispatchIndirect(inQueue);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        stamp(KERNEL_SHADOW);
+        shadow.use();
+        shadow.setInt("u_shadowCapacity", shadowCapacity);
+        dispatchIndirect(kQueueShadow);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    stamp(KERNEL_ACCUMULATE);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, prev.textureColor);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, prev.textureMoments);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, prev.textureGBuffer);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, prev.textureAlbedo);
+    glBindImageTexture(0, out.textureColor, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    glBindImageTexture(1, out.textureMoments, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+    glBindImageTexture(2, out.textureGBuffer, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+    accumulate.use();
+    accumulate.setFloat("u_sample_part", params.samplePart);
+    accumulate.setInt("u_adaptive", params.adaptive ? 1 : 0);
+    accumulate.setInt("u_reproject", params.reproject ? 1 : 0);
+    accumulate.setMat4("u_prevView", params.historyView);
+    accumulate.setVec2("u_prevResolution", params.historyResolution);
+    accumulate.setFloat("u_maxHistory", params.maxHistory);
+    glDispatchCompute(groupsX, groupsY, 1);
+    stamp(KERNEL_ACCUMULATE);
+
+    // Следующий сэмпл и экранный проход читают результат как текстуру, hoverId читается через map
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+    prevView = params.view;
+    hasHistory = useReSTIR;
+
+    if (activeTimer) {
+        activeTimer->pending = activeTimer->count > 1;
+        activeTimer = nullptr;
+    }
+}
+
+bool WavefrontTracer::pollReload() {
+    bool reloaded = false;
+    for (Shader* k : { &generate, &extend, &restirTemporal, &restirSpatial, &shade, &shadow, &accumulate }) {
+        if (k->pollReload()) reloaded = true;
+    }
+    if (reloaded) samplersSet = false;
+    return reloaded;
+}
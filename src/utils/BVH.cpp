@@ -22,14 +22,14 @@ void UpdateNodeBounds(int nodeIdx, std::vector<GPUBVHNode>& nodes, const std::ve
 }
 
 // Рекурсивная функция разделения
-void Subdivide(int nodeIdx, std::vector<GPUBVHNode>& nodes, std::vector<GPUMeshTriangle>& tris) {
+void Subdivide(int nodeIdx, std::vector<GPUBVHNode>& nodes, std::vector<GPUMeshTriangle>& tris, int depth) {
 
     int nodeLeftFirst = nodes[nodeIdx].leftFirst;
     int nodeTriCount  = nodes[nodeIdx].triCount;
     glm::vec3 nodeMin = nodes[nodeIdx].minBounds;
     glm::vec3 nodeMax = nodes[nodeIdx].maxBounds;
 
-    if (nodeTriCount <= 2) return;
+    if (nodeTriCount <= 2 || depth >= MAX_BVH_DEPTH) return;
 
     // Логика разделения
     glm::vec3 extent = nodeMax - nodeMin;
@@ -75,6 +75,6 @@ void Subdivide(int nodeIdx, std::vector<GPUBVHNode>& nodes, std::vector<GPUMeshT
     UpdateNodeBounds(leftChildIdx + 1, nodes, tris);
 
     // Рекурсия
-    Subdivide(leftChildIdx, nodes, tris);
-    Subdivide(leftChildIdx + 1, nodes, tris);
+    Subdivide(leftChildIdx, nodes, tris, depth + 1);
+    Subdivide(leftChildIdx + 1, nodes, tris, depth + 1);
 }
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "FramePacer.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+double ToMs(FramePacer::Clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+FramePacer::FramePacer() {
+    // Адаптивный vsync (swap interval -1) - через расширение *_swap_control_tear
+    adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear");
+#ifdef _WIN32
+    // Квант планировщика Windows по умолчанию ~15.6 мс: sleep_until просыпался бы позже дедлайна
+    // и порог упирался в максимум. 1 мс на всё время жизни пейсера
+    timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+    timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::applyVSync() {
+    if (vsync == appliedVSync) return;
+    if (vsync == VSYNC_ADAPTIVE && !adaptiveSupported) vsync = VSYNC_ON;
+    glfwSwapInterval(vsync == VSYNC_OFF ? 0 : (vsync == VSYNC_ON ? 1 : -1));
+    appliedVSync = vsync;
+    std::cout << "VSync: " << (vsync == VSYNC_OFF ? "off" : (vsync == VSYNC_ON ? "on" : "adaptive")) << std::endl;
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline) {
+    Clock::time_point now = Clock::now();
+    double remaining = ToMs(deadline - now);
+    if (remaining <= 0.0) return;
+
+    // Грубо спим до порога, затем уступаем поток, пока не наступит дедлайн. Порог не меньше 0.5 мс,
+    // так что после сна всегда остаётся короткое досрочное ожидание, если ОС не пересыпала сам дедлайн
+    if (remaining > spinThresholdMs) {
+        Clock::time_point wake = deadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(spinThresholdMs));
+        std::this_thread::sleep_until(wake);
+        Clock::time_point after = Clock::now();
+        sleptMs += ToMs(after - now);
+
+        // Пересып ОС растит порог, точный сон понемногу его снижает
+        double oversleep = ToMs(after - wake);
+        spinThresholdMs = std::clamp(oversleep > spinThresholdMs * 0.5 ? spinThresholdMs * 1.5 : spinThresholdMs * 0.98, 0.5, 4.0);
+        now = after;
+    }
+    while (now < deadline) {
+        std::this_thread::yield();
+        Clock::time_point t = Clock::now();
+        spunMs += ToMs(t - now);
+        now = t;
+    }
+}
+
+void FramePacer::beginFrame(int targetFPS) {
+    applyVSync();
+    period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(targetFPS, 1)));
+    if (!started) {
+        nextDeadline = Clock::now() + period;
+        lastPresent = Clock::now();
+        started = true;
+    }
+
+    // Начинаем так, чтобы кадр с запасом в два разброса закончился к дедлайну
+    if (lowLatency) {
+        double leadMs = workMs + 2.0 * workDevMs + 0.5;
+        waitUntil(nextDeadline - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(leadMs)));
+    }
+    workStart = Clock::now();
+}
+
+void FramePacer::endFrame() {
+    Clock::time_point workEnd = Clock::now();
+    double work = ToMs(workEnd - workStart);
+    workDevMs = workDevMs * 0.9 + std::fabs(work - workMs) * 0.1;
+    workMs = workMs * 0.9 + work * 0.1;
+
+    if (!lowLatency) waitUntil(nextDeadline);
+
+    // Сетка дедлайнов без дрейфа; если отстали больше чем на кадр - начинаем сетку заново
+    Clock::time_point now = Clock::now();
+    nextDeadline += period;
+    if (nextDeadline < now) nextDeadline = now + period;
+
+    double interval = ToMs(now - lastPresent);
+    lastPresent = now;
+    intervals[intervalCount++ % kHistory] = (float)interval;
+
+    int n = std::min(intervalCount, kHistory);
+    double target = ToMs(period), sum = 0.0, sumSq = 0.0, maxDev = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += intervals[i];
+        sumSq += intervals[i] * intervals[i];
+        maxDev = std::max(maxDev, std::fabs(intervals[i] - target));
+    }
+    double mean = sum / n;
+    intervalMs = (float)mean;
+    jitterMs = (float)std::sqrt(std::max(sumSq / n - mean * mean, 0.0));
+    maxDeviationMs = (float)maxDev;
+
+    double waited = sleptMs + spunMs;
+    if (waited > 0.0) idlePercent = idlePercent * 0.9f + (float)(100.0 * sleptMs / waited) * 0.1f;
+    sleptMs = spunMs = 0.0;
+}
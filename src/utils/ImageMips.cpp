@@ -0,0 +1,68 @@
+#include "ImageMips.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGEMIPS_SSE2 1
+#endif
+
+void DownsampleBox(const MipLevel& src, MipLevel& dst) {
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize((size_t)dst.width * dst.height * 4);
+
+    const int sw = src.width, sh = src.height;
+    const unsigned char* s = src.pixels.data();
+    unsigned char* d = dst.pixels.data();
+
+    for (int y = 0; y < dst.height; y++) {
+        int sy0 = std::min(y * 2, sh - 1);
+        int sy1 = std::min(y * 2 + 1, sh - 1);
+        const unsigned char* r0 = s + (size_t)sy0 * sw * 4;
+        const unsigned char* r1 = s + (size_t)sy1 * sw * 4;
+        unsigned char* out = d + (size_t)y * dst.width * 4;
+
+        int x = 0;
+#ifdef IMAGEMIPS_SSE2
+        // По 4 выходных пикселя: вертикальное среднее двух строк, потом чётные/нечётные пиксели
+        if (sw >= 2) {
+            for (; x + 4 <= dst.width && (x * 2 + 8) <= sw; x += 4) {
+                __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x * 8));
+                __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + x * 8 + 16));
+                __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + x * 8));
+                __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + x * 8 + 16));
+                __m128 v0 = _mm_castsi128_ps(_mm_avg_epu8(a0, b0));
+                __m128 v1 = _mm_castsi128_ps(_mm_avg_epu8(a1, b1));
+                __m128i even = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2, 0, 2, 0)));
+                __m128i odd  = _mm_castps_si128(_mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3, 1, 3, 1)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_avg_epu8(even, odd));
+            }
+        }
+#endif
+        for (; x < dst.width; x++) {
+            int sx0 = std::min(x * 2, sw - 1);
+            int sx1 = std::min(x * 2 + 1, sw - 1);
+            // Та же схема округления, что у _mm_avg_epu8, чтобы хвост строки не отличался от SIMD-части
+            for (int c = 0; c < 4; c++) {
+                int left = (r0[sx0 * 4 + c] + r1[sx0 * 4 + c] + 1) >> 1;
+                int right = (r0[sx1 * 4 + c] + r1[sx1 * 4 + c] + 1) >> 1;
+                out[x * 4 + c] = (unsigned char)((left + right + 1) >> 1);
+            }
+        }
+    }
+}
+
+std::vector<MipLevel> BuildMipChain(const unsigned char* rgba, int width, int height) {
+    std::vector<MipLevel> chain(1);
+    chain[0].width = width;
+    chain[0].height = height;
+    chain[0].pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+    while (chain.back().width > 1 || chain.back().height > 1) {
+        MipLevel next;
+        DownsampleBox(chain.back(), next);
+        chain.push_back(std::move(next));
+    }
+    return chain;
+}
@@ -0,0 +1,296 @@
+#include "MeshLOD.h"
+#include "BVH.h"
+
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+LODSettings lodSettings;
+std::vector<std::vector<MeshLOD>> allMeshLODs;
+
+namespace {
+
+// Симметричная матрица 4x4 квадрики, храним только верхний треугольник
+struct Quadric {
+    double m[10] = {0};
+
+    void addPlane(double a, double b, double c, double d, double w) {
+        m[0] += w*a*a; m[1] += w*a*b; m[2] += w*a*c; m[3] += w*a*d;
+                       m[4] += w*b*b; m[5] += w*b*c; m[6] += w*b*d;
+                                      m[7] += w*c*c; m[8] += w*c*d;
+                                                     m[9] += w*d*d;
+    }
+
+    Quadric& operator+=(const Quadric& o) {
+        for (int i = 0; i < 10; i++) m[i] += o.m[i];
+        return *this;
+    }
+
+    double error(const glm::vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return m[0]*x*x + 2*m[1]*x*y + 2*m[2]*x*z + 2*m[3]*x
+                        +   m[4]*y*y + 2*m[5]*y*z + 2*m[6]*y
+                                     +   m[7]*z*z + 2*m[8]*z
+                                                  +   m[9];
+    }
+
+    // Точка минимума: решаем 3x3 систему по Крамеру
+    bool optimum(glm::vec3& out) const {
+        double a = m[0], b = m[1], c = m[2];
+        double e = m[4], f = m[5], h = m[7];
+        double det = a*(e*h - f*f) - b*(b*h - f*c) + c*(b*f - e*c);
+        if (std::abs(det) < 1e-12) return false;
+        double r0 = -m[3], r1 = -m[6], r2 = -m[8];
+        double x = (r0*(e*h - f*f) - b*(r1*h - f*r2) + c*(r1*f - e*r2)) / det;
+        double y = (a*(r1*h - f*r2) - r0*(b*h - f*c) + c*(b*r2 - r1*c)) / det;
+        double z = (a*(e*r2 - r1*f) - b*(b*r2 - r1*c) + r0*(b*f - e*c)) / det;
+        out = glm::vec3((float)x, (float)y, (float)z);
+        return true;
+    }
+};
+
+struct Face {
+    int v[3];
+    glm::vec3 color;
+    int attribId;
+    bool removed;
+};
+
+struct Collapse {
+    double cost;
+    int a, b;
+    unsigned stampA, stampB;
+    glm::vec3 target;
+    bool operator>(const Collapse& o) const { return cost > o.cost; }
+};
+
+uint64_t EdgeKey(int a, int b) {
+    if (a > b) std::swap(a, b);
+    return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+}
+
+glm::vec3 FaceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    return glm::cross(b - a, c - a);
+}
+
+} // namespace
+
+std::vector<GPUMeshTriangle> SimplifyMesh(const std::vector<GPUMeshTriangle>& tris, size_t targetTriCount) {
+    // --- СВАРКА ВЕРШИН ---
+    // В GPUMeshTriangle вершины продублированы, а у общих вершин координаты совпадают побитово
+    std::vector<glm::vec3> positions;
+    std::vector<Face> faces;
+    faces.reserve(tris.size());
+    std::unordered_map<PosKey, int, PosKeyHash> weld;
+    weld.reserve(tris.size());
+
+    auto weldVertex = [&](const glm::vec3& p) {
+        PosKey key = MakePosKey(p);
+        auto it = weld.find(key);
+        if (it != weld.end()) return it->second;
+        int idx = (int)positions.size();
+        positions.push_back(p);
+        weld.emplace(key, idx);
+        return idx;
+    };
+
+    for (const GPUMeshTriangle& t : tris) {
+        Face f;
+        f.v[0] = weldVertex(t.v0);
+        f.v[1] = weldVertex(t.v1);
+        f.v[2] = weldVertex(t.v2);
+        f.color = t.color;
+        f.attribId = t.attribId; // UV исходного треугольника - на упрощённом уровне это приближение
+        f.removed = (f.v[0] == f.v[1] || f.v[1] == f.v[2] || f.v[0] == f.v[2]);
+        faces.push_back(f);
+    }
+    weld.clear();
+
+    // --- КВАДРИКИ И СМЕЖНОСТЬ ---
+    std::vector<Quadric> quadrics(positions.size());
+    std::vector<std::vector<int>> vertFaces(positions.size());
+    std::unordered_map<uint64_t, int> edgeFaces;
+    edgeFaces.reserve(faces.size() * 2);
+
+    size_t liveFaces = 0;
+    for (int fi = 0; fi < (int)faces.size(); fi++) {
+        Face& f = faces[fi];
+        if (f.removed) continue;
+        liveFaces++;
+        const glm::vec3& p0 = positions[f.v[0]];
+        glm::vec3 n = FaceNormal(p0, positions[f.v[1]], positions[f.v[2]]);
+        float len = glm::length(n);
+        if (len > 0.0f) {
+            n /= len;
+            double area = 0.5 * len;
+            for (int k = 0; k < 3; k++) {
+                quadrics[f.v[k]].addPlane(n.x, n.y, n.z, -glm::dot(n, p0), area);
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            vertFaces[f.v[k]].push_back(fi);
+            edgeFaces[EdgeKey(f.v[k], f.v[(k + 1) % 3])]++;
+        }
+    }
+
+    // Края открытых сканов: добавляем перпендикулярную плоскость с большим весом, чтобы не "съедать" контур
+    const double boundaryWeight = 1000.0;
+    for (const Face& f : faces) {
+        if (f.removed) continue;
+        glm::vec3 fn = FaceNormal(positions[f.v[0]], positions[f.v[1]], positions[f.v[2]]);
+        for (int k = 0; k < 3; k++) {
+            int a = f.v[k], b = f.v[(k + 1) % 3];
+            if (edgeFaces[EdgeKey(a, b)] != 1) continue;
+            glm::vec3 edge = positions[b] - positions[a];
+            glm::vec3 n = glm::cross(edge, fn);
+            float len = glm::length(n);
+            if (len <= 0.0f) continue;
+            n /= len;
+            double d = -glm::dot(n, positions[a]);
+            double w = boundaryWeight * glm::dot(edge, edge);
+            quadrics[a].addPlane(n.x, n.y, n.z, d, w);
+            quadrics[b].addPlane(n.x, n.y, n.z, d, w);
+        }
+    }
+
+    // --- ОЧЕРЕДЬ СХЛОПЫВАНИЙ ---
+    std::vector<unsigned> stamps(positions.size(), 0);
+    std::vector<bool> vertRemoved(positions.size(), false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+    auto pushEdge = [&](int a, int b) {
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        Collapse c;
+        c.a = a; c.b = b;
+        c.stampA = stamps[a]; c.stampB = stamps[b];
+        if (!q.optimum(c.target)) {
+            // Вырожденная квадрика (плоский участок) - берём лучший из концов и середины
+            glm::vec3 mid = (positions[a] + positions[b]) * 0.5f;
+            double ea = q.error(positions[a]), eb = q.error(positions[b]), em = q.error(mid);
+            c.target = mid;
+            if (ea < em && ea <= eb) c.target = positions[a];
+            else if (eb < em) c.target = positions[b];
+        }
+        c.cost = q.error(c.target);
+        heap.push(c);
+    };
+
+    for (const auto& e : edgeFaces) {
+        pushEdge((int)(e.first >> 32), (int)(e.first & 0xFFFFFFFFu));
+    }
+    edgeFaces.clear();
+
+    // Проверка, что после перемещения вершины ни один треугольник не перевернётся
+    auto flips = [&](int v, int other, const glm::vec3& target) {
+        for (int fi : vertFaces[v]) {
+            const Face& f = faces[fi];
+            if (f.removed) continue;
+            if (f.v[0] == other || f.v[1] == other || f.v[2] == other) continue;
+            glm::vec3 p[3] = { positions[f.v[0]], positions[f.v[1]], positions[f.v[2]] };
+            glm::vec3 before = FaceNormal(p[0], p[1], p[2]);
+            for (int k = 0; k < 3; k++) if (f.v[k] == v) p[k] = target;
+            glm::vec3 after = FaceNormal(p[0], p[1], p[2]);
+            if (glm::dot(before, after) <= 0.0f) return true;
+        }
+        return false;
+    };
+
+    std::vector<int> neighbours;
+    while (liveFaces > targetTriCount && !heap.empty()) {
+        Collapse c = heap.top();
+        heap.pop();
+
+        if (vertRemoved[c.a] || vertRemoved[c.b]) continue;
+        if (stamps[c.a] != c.stampA || stamps[c.b] != c.stampB) continue;
+        if (flips(c.a, c.b, c.target) || flips(c.b, c.a, c.target)) continue;
+
+        int a = c.a, b = c.b;
+        positions[a] = c.target;
+        quadrics[a] += quadrics[b];
+        vertRemoved[b] = true;
+
+        // Переносим треугольники b на a, общие для ребра - выкидываем
+        for (int fi : vertFaces[b]) {
+            Face& f = faces[fi];
+            if (f.removed) continue;
+            if (f.v[0] == a || f.v[1] == a || f.v[2] == a) {
+                f.removed = true;
+                liveFaces--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) if (f.v[k] == b) f.v[k] = a;
+            vertFaces[a].push_back(fi);
+        }
+        vertFaces[b].clear();
+        vertFaces[b].shrink_to_fit();
+
+        // Чистим список a и собираем соседей для пересчёта рёбер
+        std::vector<int>& fa = vertFaces[a];
+        fa.erase(std::remove_if(fa.begin(), fa.end(), [&](int fi) { return faces[fi].removed; }), fa.end());
+
+        stamps[a]++;
+        neighbours.clear();
+        for (int fi : fa) {
+            for (int k = 0; k < 3; k++) {
+                int n = faces[fi].v[k];
+                if (n != a) neighbours.push_back(n);
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        for (int n : neighbours) pushEdge(a, n);
+    }
+
+    // --- СБОРКА РЕЗУЛЬТАТА ---
+    std::vector<GPUMeshTriangle> out;
+    out.reserve(liveFaces);
+    for (const Face& f : faces) {
+        if (f.removed) continue;
+        GPUMeshTriangle t{};
+        t.v0 = positions[f.v[0]];
+        t.v1 = positions[f.v[1]];
+        t.v2 = positions[f.v[2]];
+        t.color = f.color;
+        t.attribId = f.attribId;
+        out.push_back(t);
+    }
+    return out;
+}
+
+int PickLODForBudget(int objectIdx, size_t triBudget) {
+    const std::vector<MeshLOD>& lods = allMeshLODs[objectIdx];
+    for (int level = 0; level < (int)lods.size(); level++) {
+        if ((size_t)lods[level].triCount <= triBudget) return level;
+    }
+    return (int)lods.size() - 1;
+}
+
+bool ApplyLOD(bool fullDetail) {
+    bool changed = false;
+    size_t count = std::min(allObjects.size(), allMeshLODs.size());
+    for (size_t i = 0; i < count; i++) {
+        if (allMeshLODs[i].empty()) continue;
+        int level = (fullDetail || !lodSettings.enabled) ? 0 : PickLODForBudget((int)i, lodSettings.interactiveBudget);
+        int root = allMeshLODs[i][level].bvhRootIndex;
+        if (allObjects[i].bvhRootIndex != root) {
+            allObjects[i].bvhRootIndex = root;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+size_t ActiveTriangleCount() {
+    size_t total = 0;
+    size_t count = std::min(allObjects.size(), allMeshLODs.size());
+    for (size_t i = 0; i < count; i++) {
+        for (const MeshLOD& lod : allMeshLODs[i]) {
+            if (lod.bvhRootIndex == allObjects[i].bvhRootIndex) { total += lod.triCount; break; }
+        }
+    }
+    return total;
+}
@@ -1,18 +1,262 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include "tiny_gltf.h"
+#include "json.hpp"
 
 #include "ModelLoader.h"
+#include "MappedFile.h"
+#include "ImageMips.h"
+#include "stb_image.h"
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <unordered_map>
+#include <thread>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include "BVH.h"
+#include "MeshLOD.h"
 
 std::vector<GPUMeshTriangle> allTriangles;
+std::vector<GPUQuantTriangle> allQuantTriangles;
+std::vector<float> allVertices;
+std::vector<GPUIndexedTriangle> allIndexedTriangles;
+GeometrySettings geometrySettings;
+std::vector<GPUTriangleAttrib> allTriangleAttribs;
+std::vector<GPUMaterial> allMaterials;
 
-void ProcessNode(const tinygltf::Model& model, const tinygltf::Node& node, glm::mat4 currentTransform, std::vector<GPUMeshTriangle>& outTriangles) {
+// Декодированные base color картинки, индекс = GPUMaterial::textureLayer. Живут до PackMaterialLayers,
+// там textureLayer переводится в слой своей корзины
+static std::vector<MipLevel> materialImages;
+
+// Откуда брать байты буферов: из tinygltf::Buffer::data или прямо из замапленного BIN-чанка GLB
+struct GLTFSource {
+    tinygltf::Model model;
+    std::vector<const unsigned char*> buffers; // Начало каждого буфера
+    std::vector<int> glbImageViews;             // image -> bufferView для картинок, которые tinygltf не декодировал
+    MappedFile file;
+};
+
+const unsigned char* AccessorData(const GLTFSource& src, const tinygltf::Accessor& accessor) {
+    const tinygltf::BufferView& bufferView = src.model.bufferViews[accessor.bufferView];
+    return src.buffers[bufferView.buffer] + bufferView.byteOffset + accessor.byteOffset;
+}
+
+inline uint32_t ReadIndex(const unsigned char* data, int componentType, size_t i) {
+    switch (componentType) {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return reinterpret_cast<const unsigned short*>(data)[i];
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:   return reinterpret_cast<const unsigned int*>(data)[i];
+        default:                                     return data[i];
+    }
+}
+
+// Одна компонента атрибута в float. Нормализованные целые - по формулам из спеки glTF
+float DecodeComponent(const unsigned char* p, int componentType, bool normalized) {
+    switch (componentType) {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: { float v; std::memcpy(&v, p, 4); return v; }
+        case TINYGLTF_COMPONENT_TYPE_BYTE: { float v = (float)*reinterpret_cast<const int8_t*>(p); return normalized ? std::max(v / 127.0f, -1.0f) : v; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: { float v = (float)*p; return normalized ? v / 255.0f : v; }
+        case TINYGLTF_COMPONENT_TYPE_SHORT: { int16_t v; std::memcpy(&v, p, 2); return normalized ? std::max(v / 32767.0f, -1.0f) : (float)v; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: { uint16_t v; std::memcpy(&v, p, 2); return normalized ? v / 65535.0f : (float)v; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: { uint32_t v; std::memcpy(&v, p, 4); return (float)v; }
+        default: return 0.0f;
+    }
+}
+
+// Чтение атрибута любого формата: float, квантованные и нормализованные целые (KHR_mesh_quantization),
+// произвольный byteStride и sparse-аксессоры (их раскрываем в dense один раз)
+struct AccessorReader {
+    const unsigned char* data = nullptr;
+    size_t stride = 0;
+    int componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    int componentSize = 4;
+    int components = 0;
+    bool normalized = false;
+    size_t count = 0;
+    std::vector<float> dense;
+
+    float component(size_t i, int c) const {
+        if (i >= count) return 0.0f;
+        if (!dense.empty()) return dense[i * components + c];
+        if (!data) return 0.0f;
+        return DecodeComponent(data + i * stride + c * componentSize, componentType, normalized);
+    }
+
+    glm::vec3 vec3(size_t i) const { return glm::vec3(component(i, 0), component(i, 1), component(i, 2)); }
+    glm::vec2 vec2(size_t i) const { return glm::vec2(component(i, 0), component(i, 1)); }
+};
+
+AccessorReader MakeAccessorReader(const GLTFSource& src, const tinygltf::Accessor& accessor) {
+    const tinygltf::Model& model = src.model;
+    AccessorReader r;
+    r.componentType = accessor.componentType;
+    r.componentSize = tinygltf::GetComponentSizeInBytes((uint32_t)accessor.componentType);
+    r.components = tinygltf::GetNumComponentsInType((uint32_t)accessor.type);
+    r.normalized = accessor.normalized;
+    r.count = accessor.count;
+
+    if (accessor.bufferView >= 0) {
+        const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+        r.data = AccessorData(src, accessor);
+        r.stride = (size_t)std::max(0, accessor.ByteStride(view));
+    }
+
+    if (accessor.sparse.isSparse && r.components > 0) {
+        // База (или нули, если bufferView нет) + подмена значений по индексам.
+        // Базу читаем прямо из буфера: component() при непустом dense читает уже из dense
+        r.dense.resize(accessor.count * r.components, 0.0f);
+        for (size_t i = 0; r.data && i < accessor.count; i++) {
+            for (int c = 0; c < r.components; c++) {
+                r.dense[i * r.components + c] = DecodeComponent(r.data + i * r.stride + c * r.componentSize, r.componentType, r.normalized);
+            }
+        }
+
+        const auto& sparse = accessor.sparse;
+        const tinygltf::BufferView& indexView = model.bufferViews[sparse.indices.bufferView];
+        const tinygltf::BufferView& valueView = model.bufferViews[sparse.values.bufferView];
+        const unsigned char* indices = src.buffers[indexView.buffer] + indexView.byteOffset + sparse.indices.byteOffset;
+        const unsigned char* values = src.buffers[valueView.buffer] + valueView.byteOffset + sparse.values.byteOffset;
+        size_t elementSize = (size_t)r.componentSize * r.components;
+
+        for (int k = 0; k < sparse.count; k++) {
+            uint32_t target = ReadIndex(indices, sparse.indices.componentType, k);
+            if (target >= accessor.count) continue;
+            for (int c = 0; c < r.components; c++) {
+                r.dense[target * r.components + c] = DecodeComponent(values + k * elementSize + c * r.componentSize, r.componentType, r.normalized);
+            }
+        }
+    }
+    return r;
+}
+
+// Ридеры общие для всех нод, которые ссылаются на один аксессор (std::map - указатели стабильны)
+const AccessorReader* GetAccessorReader(const GLTFSource& src, std::map<int, AccessorReader>& readers, int accessorIdx) {
+    auto it = readers.find(accessorIdx);
+    if (it == readers.end()) it = readers.emplace(accessorIdx, MakeAccessorReader(src, src.model.accessors[accessorIdx])).first;
+    return &it->second;
+}
+
+// GLB без копий: мапим файл, tinygltf отдаём только JSON-чанк.
+// Буферы без uri (это BIN-чанк) подменяем заглушкой, а читаем их потом напрямую из отображения
+bool LoadGLBMapped(const std::string& filename, GLTFSource& src, std::string& err, std::string& warn) {
+    if (!src.file.open(filename)) { err = "Cannot map file"; return false; }
+
+    const unsigned char* bytes = src.file.data;
+    size_t size = src.file.size;
+    if (size < 20) { err = "GLB too small"; return false; }
+
+    uint32_t magic, version, length, jsonLength, jsonFormat;
+    std::memcpy(&magic, bytes, 4);
+    std::memcpy(&version, bytes + 4, 4);
+    std::memcpy(&length, bytes + 8, 4);
+    std::memcpy(&jsonLength, bytes + 12, 4);
+    std::memcpy(&jsonFormat, bytes + 16, 4);
+
+    if (magic != 0x46546C67 || version != 2 || length > size || jsonFormat != 0x4E4F534A || 20ull + jsonLength > length) {
+        err = "Invalid GLB header";
+        return false;
+    }
+
+    const unsigned char* bin = nullptr;
+    size_t binHeader = 20 + (size_t)jsonLength;
+    if (binHeader + 8 <= length) {
+        uint32_t binLength, binFormat;
+        std::memcpy(&binLength, bytes + binHeader, 4);
+        std::memcpy(&binFormat, bytes + binHeader + 4, 4);
+        if (binFormat == 0x004E4942 && binHeader + 8 + binLength <= length) bin = bytes + binHeader + 8;
+    }
+
+    nlohmann::json json = nlohmann::json::parse(bytes + 20, bytes + 20 + jsonLength, nullptr, false);
+    if (json.is_discarded()) { err = "Invalid GLB JSON chunk"; return false; }
+
+    // 4 нулевых байта в base64 - tinygltf не принимает пустые data uri
+    const char* placeholderBuffer = "data:application/octet-stream;base64,AAAAAA==";
+    const char* placeholderImage = "data:image/png;base64,AAAAAA==";
+
+    std::vector<bool> fromBin;
+    if (json.contains("buffers")) {
+        for (auto& buffer : json["buffers"]) {
+            bool inBin = !buffer.contains("uri");
+            fromBin.push_back(inBin);
+            if (inBin) {
+                buffer["uri"] = placeholderBuffer;
+                buffer["byteLength"] = 4;
+            }
+        }
+    }
+
+    if (json.contains("images")) {
+        for (auto& image : json["images"]) {
+            int view = -1;
+            if (image.contains("bufferView")) {
+                view = image["bufferView"].get<int>();
+                image.erase("bufferView");
+                image["uri"] = placeholderImage;
+            }
+            src.glbImageViews.push_back(view);
+        }
+    }
+
+    std::string jsonText = json.dump();
+    json = nlohmann::json();
+
+    tinygltf::TinyGLTF loader;
+    loader.SetImageLoader([](tinygltf::Image* image, const int imageIdx, std::string* imgErr, std::string* imgWarn,
+                             int reqW, int reqH, const unsigned char* data, int dataSize, void* user) {
+        const std::vector<int>& views = *static_cast<const std::vector<int>*>(user);
+        if (imageIdx < (int)views.size() && views[imageIdx] >= 0) return true;
+        return tinygltf::LoadImageData(image, imageIdx, imgErr, imgWarn, reqW, reqH, data, dataSize, nullptr);
+    }, &src.glbImageViews);
+
+    std::string baseDir;
+    size_t slash = filename.find_last_of("/\\");
+    if (slash != std::string::npos) baseDir = filename.substr(0, slash + 1);
+
+    if (!loader.LoadASCIIFromString(&src.model, &err, &warn, jsonText.c_str(), (unsigned int)jsonText.size(), baseDir)) return false;
+
+    src.buffers.resize(src.model.buffers.size());
+    for (size_t i = 0; i < src.model.buffers.size(); i++) {
+        if (i < fromBin.size() && fromBin[i]) {
+            if (!bin) { err = "GLB buffer without BIN chunk"; return false; }
+            src.buffers[i] = bin;
+        } else {
+            src.buffers[i] = src.model.buffers[i].data.data();
+        }
+    }
+    return true;
+}
+
+// Один примитив, который нужно развернуть в треугольники (результат первого прохода)
+struct PrimitiveJob {
+    const tinygltf::Primitive* primitive;
+    const AccessorReader* positions;
+    const AccessorReader* uvs; // nullptr - у примитива нет текстуры
+    glm::mat4 transform;
+    glm::vec3 color;
+    int materialId;            // Глобальный индекс в allMaterials
+    size_t firstTri;           // Куда писать в выходной массив
+    size_t firstAttrib;        // То же для атрибутов (только если uvs != nullptr)
+    size_t triCount;
+};
+
+// Состояние первого прохода
+struct CollectState {
+    std::map<int, AccessorReader> readers;
+    std::vector<PrimitiveJob> jobs;
+    size_t totalTris = 0;
+    size_t totalAttribs = 0;
+    int materialBase = 0;               // allMaterials.size() до этой модели
+    std::vector<int> materialTexCoord;  // Номер TEXCOORD_n для base color или -1
+};
+
+// Первый проход: обходим дерево узлов, считаем глобальные матрицы и точное число треугольников
+void CollectPrimitives(const GLTFSource& src, const tinygltf::Node& node, glm::mat4 currentTransform, CollectState& state) {
     
     // Вычисляем матрицу
     glm::mat4 localTransform = glm::mat4(1.0f);
@@ -33,6 +277,7 @@ void ProcessNode(const tinygltf::Model& model, const tinygltf::Node& node, glm::
         }
     }
     glm::mat4 globalTransform = currentTransform * localTransform;
+    const tinygltf::Model& model = src.model;
 
     // Обрабатываем Меш
     if (node.mesh >= 0) {
@@ -40,6 +285,7 @@ void ProcessNode(const tinygltf::Model& model, const tinygltf::Node& node, glm::
 
         for (const auto& primitive : mesh.primitives) {
             if (primitive.mode != TINYGLTF_MODE_TRIANGLES) continue;
+            if (primitive.attributes.find("POSITION") == primitive.attributes.end()) continue;
 
             // --- ЧТЕНИЕ МАТЕРИАЛА ---
             glm::vec3 meshColor = glm::vec3(0.8f); // Серый по умолчанию
@@ -55,116 +301,605 @@ void ProcessNode(const tinygltf::Model& model, const tinygltf::Node& node, glm::
                 }
             }
 
-            const float* positionBuffer = nullptr;
-            if (primitive.attributes.find("POSITION") != primitive.attributes.end()) {
-                const tinygltf::Accessor& accessor = model.accessors[primitive.attributes.at("POSITION")];
-                const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-                positionBuffer = reinterpret_cast<const float*>(&buffer.data[bufferView.byteOffset + accessor.byteOffset]);
-            } else continue;
-
+            size_t triCount = 0;
             if (primitive.indices >= 0) {
                 const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
-                const tinygltf::BufferView& bufferView = model.bufferViews[indexAccessor.bufferView];
-                const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-
-                for (size_t i = 0; i < indexAccessor.count; i += 3) {
-                    int i0, i1, i2;
-                    if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-                        const unsigned short* buf = reinterpret_cast<const unsigned short*>(&buffer.data[bufferView.byteOffset + indexAccessor.byteOffset]);
-                        i0 = buf[i]; i1 = buf[i+1]; i2 = buf[i+2];
-                    } else if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-                        const unsigned int* buf = reinterpret_cast<const unsigned int*>(&buffer.data[bufferView.byteOffset + indexAccessor.byteOffset]);
-                        i0 = buf[i]; i1 = buf[i+1]; i2 = buf[i+2];
-                    } else if (indexAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-                        const unsigned char* buf = reinterpret_cast<const unsigned char*>(&buffer.data[bufferView.byteOffset + indexAccessor.byteOffset]);
-                        i0 = buf[i]; i1 = buf[i+1]; i2 = buf[i+2];
-                    } else continue;
-
-                    auto getVert = [&](int index) {
-                        glm::vec4 v = glm::vec4(positionBuffer[index*3], positionBuffer[index*3+1], positionBuffer[index*3+2], 1.0f);
-                        return glm::vec3(globalTransform * v);
-                    };
-
-                    GPUMeshTriangle tri;
-                    tri.v0 = getVert(i0);
-                    tri.v1 = getVert(i1);
-                    tri.v2 = getVert(i2);
-                    tri.color = meshColor; // ПРИМЕНЯЕМ ЦВЕТ
-                    
-                    outTriangles.push_back(tri);
+                int type = indexAccessor.componentType;
+                if (type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+                    type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT &&
+                    type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) continue;
+                triCount = indexAccessor.count / 3;
+            } else {
+                triCount = model.accessors[primitive.attributes.at("POSITION")].count / 3;
+            }
+            if (triCount == 0) continue;
+
+            const AccessorReader* positions = GetAccessorReader(src, state.readers, primitive.attributes.at("POSITION"));
+            if (positions->components < 3) continue;
+
+            // --- UV ДЛЯ BASE COLOR ТЕКСТУРЫ ---
+            const AccessorReader* uvs = nullptr;
+            int materialId = -1;
+            if (primitive.material >= 0 && state.materialTexCoord[primitive.material] >= 0) {
+                auto uvIt = primitive.attributes.find("TEXCOORD_" + std::to_string(state.materialTexCoord[primitive.material]));
+                if (uvIt != primitive.attributes.end()) {
+                    uvs = GetAccessorReader(src, state.readers, uvIt->second);
+                    if (uvs->components < 2) uvs = nullptr;
+                    else materialId = state.materialBase + primitive.material;
                 }
             }
+
+            state.jobs.push_back({&primitive, positions, uvs, globalTransform, meshColor, materialId, state.totalTris, uvs ? state.totalAttribs : 0, triCount});
+            state.totalTris += triCount;
+            if (uvs) state.totalAttribs += triCount;
         }
     }
 
     // Дети
     for (int childIndex : node.children) {
-        ProcessNode(model, model.nodes[childIndex], globalTransform, outTriangles);
+        CollectPrimitives(src, model.nodes[childIndex], globalTransform, state);
+    }
+}
+
+// Второй проход: пишем треугольники [triBegin, triEnd) примитива прямо на их место в out
+void FlattenPrimitive(const GLTFSource& src, const PrimitiveJob& job, size_t triBegin, size_t triEnd, GPUMeshTriangle* out, GPUTriangleAttrib* outAttribs) {
+    const tinygltf::Model& model = src.model;
+    const tinygltf::Primitive& primitive = *job.primitive;
+
+
+    const unsigned char* indexData = nullptr;
+    int indexType = 0;
+    if (primitive.indices >= 0) {
+        const tinygltf::Accessor& indexAccessor = model.accessors[primitive.indices];
+        indexData = AccessorData(src, indexAccessor);
+        indexType = indexAccessor.componentType;
+    }
+
+    auto getVert = [&](uint32_t index) {
+        glm::vec4 v = glm::vec4(job.positions->vec3(index), 1.0f);
+        return glm::vec3(job.transform * v);
+    };
+
+    for (size_t t = triBegin; t < triEnd; t++) {
+        uint32_t i0 = (uint32_t)(t * 3), i1 = i0 + 1, i2 = i0 + 2;
+        if (indexData) {
+            i0 = ReadIndex(indexData, indexType, t * 3);
+            i1 = ReadIndex(indexData, indexType, t * 3 + 1);
+            i2 = ReadIndex(indexData, indexType, t * 3 + 2);
+        }
+
+        GPUMeshTriangle& tri = out[job.firstTri + t];
+        tri = GPUMeshTriangle{};
+        tri.v0 = getVert(i0);
+        tri.v1 = getVert(i1);
+        tri.v2 = getVert(i2);
+        tri.color = job.color; // ПРИМЕНЯЕМ ЦВЕТ
+        tri.attribId = -1;
+
+        if (job.uvs) {
+            size_t attribIdx = job.firstAttrib + t;
+            GPUTriangleAttrib& attrib = outAttribs[attribIdx];
+            attrib.uv0 = job.uvs->vec2(i0);
+            attrib.uv1 = job.uvs->vec2(i1);
+            attrib.uv2 = job.uvs->vec2(i2);
+            attrib.materialId = job.materialId;
+            attrib.pad = 0;
+            tri.attribId = (int32_t)attribIdx; // Локальный индекс, сдвигается при добавлении в allTriangleAttribs
+        }
+    }
+}
+
+// Разворачивает все примитивы сцены в заранее выделенный массив на всех ядрах
+void FlattenScene(const GLTFSource& src, const CollectState& state, std::vector<GPUMeshTriangle>& outTriangles, std::vector<GPUTriangleAttrib>& outAttribs) {
+    const std::vector<PrimitiveJob>& jobs = state.jobs;
+    outTriangles.resize(state.totalTris);
+    outAttribs.resize(state.totalAttribs);
+
+    // Большие примитивы режем на куски, чтобы один огромный меш тоже грузил все потоки
+    const size_t chunkTris = 65536;
+    struct Task { size_t job, begin, end; };
+    std::vector<Task> tasks;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        for (size_t b = 0; b < jobs[j].triCount; b += chunkTris) {
+            tasks.push_back({j, b, std::min(b + chunkTris, jobs[j].triCount)});
+        }
+    }
+
+    std::atomic<size_t> nextTask{0};
+    auto worker = [&]() {
+        for (size_t t = nextTask++; t < tasks.size(); t = nextTask++) {
+            FlattenPrimitive(src, jobs[tasks[t].job], tasks[t].begin, tasks[t].end, outTriangles.data(), outAttribs.data());
+        }
+    };
+
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), tasks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) threads.emplace_back(worker);
+    worker();
+    for (std::thread& th : threads) th.join();
+}
+
+// --- КВАНТОВАНИЕ ---
+// Сетка 65535 шагов на AABB объекта. Распаковка ровно та же, что в шейдере: qMin + q * (extent / 65535)
+uint16_t QuantizeComponent(float v, float qMin, float extent) {
+    if (extent <= 0.0f) return 0;
+    float t = glm::clamp((v - qMin) / extent, 0.0f, 1.0f);
+    return (uint16_t)std::lround(t * 65535.0f);
+}
+
+glm::vec3 SnapToGrid(const glm::vec3& p, const glm::vec3& qMin, const glm::vec3& qMax) {
+    glm::vec3 extent = qMax - qMin;
+    glm::vec3 q((float)QuantizeComponent(p.x, qMin.x, extent.x),
+                (float)QuantizeComponent(p.y, qMin.y, extent.y),
+                (float)QuantizeComponent(p.z, qMin.z, extent.z));
+    return qMin + q * (extent / 65535.0f);
+}
+
+// Двигаем вершины на сетку до постройки BVH, чтобы боксы узлов точно совпали с тем, что распакует GPU
+void SnapTriangles(std::vector<GPUMeshTriangle>& tris, const glm::vec3& qMin, const glm::vec3& qMax) {
+    for (GPUMeshTriangle& t : tris) {
+        t.v0 = SnapToGrid(t.v0, qMin, qMax);
+        t.v1 = SnapToGrid(t.v1, qMin, qMax);
+        t.v2 = SnapToGrid(t.v2, qMin, qMax);
+    }
+}
+
+uint32_t PackColorRGBA8(const glm::vec3& c) {
+    auto unorm8 = [](float v) { return (uint32_t)std::lround(glm::clamp(v, 0.0f, 1.0f) * 255.0f); };
+    return unorm8(c.r) | (unorm8(c.g) << 8) | (unorm8(c.b) << 16) | (255u << 24);
+}
+
+GPUQuantTriangle QuantizeTriangle(const GPUMeshTriangle& t, const glm::vec3& qMin, const glm::vec3& qMax) {
+    glm::vec3 extent = qMax - qMin;
+    auto q = [&](const glm::vec3& p, int axis) { return (uint32_t)QuantizeComponent(p[axis], qMin[axis], extent[axis]); };
+
+    GPUQuantTriangle out;
+    out.p0 = q(t.v0, 0) | (q(t.v0, 1) << 16);
+    out.p1 = q(t.v0, 2) | (q(t.v1, 0) << 16);
+    out.p2 = q(t.v1, 1) | (q(t.v1, 2) << 16);
+    out.p3 = q(t.v2, 0) | (q(t.v2, 1) << 16);
+    out.p4 = q(t.v2, 2);
+    out.color = PackColorRGBA8(t.color);
+    out.attribId = t.attribId;
+    out.pad = 0;
+    return out;
+}
+
+// --- ИНДЕКСИРОВАННАЯ ГЕОМЕТРИЯ ---
+// Сваривает побитово совпадающие вершины и дописывает треугольники в allVertices / allIndexedTriangles
+void AppendIndexed(const std::vector<GPUMeshTriangle>& tris) {
+    std::unordered_map<PosKey, uint32_t, PosKeyHash> weld;
+    weld.reserve(tris.size() * 2);
+
+    auto vertexIndex = [&](const glm::vec3& p) {
+        PosKey key = MakePosKey(p);
+        auto it = weld.find(key);
+        if (it != weld.end()) return it->second;
+        uint32_t idx = (uint32_t)(allVertices.size() / 3);
+        allVertices.push_back(p.x);
+        allVertices.push_back(p.y);
+        allVertices.push_back(p.z);
+        weld.emplace(key, idx);
+        return idx;
+    };
+
+    allIndexedTriangles.reserve(allIndexedTriangles.size() + tris.size());
+    for (const GPUMeshTriangle& t : tris) {
+        GPUIndexedTriangle it;
+        it.i0 = vertexIndex(t.v0);
+        it.i1 = vertexIndex(t.v1);
+        it.i2 = vertexIndex(t.v2);
+        it.color = PackColorRGBA8(t.color);
+        it.attribId = t.attribId;
+        allIndexedTriangles.push_back(it);
     }
 }
 
+// Строит BVH для набора треугольников и дописывает их в общие буферы. Возвращает корень
+int AppendMeshBVH(std::vector<GPUMeshTriangle>& tris, const glm::vec3& qMin, const glm::vec3& qMax) {
+    GPUBVHNode rootNode;
+    rootNode.leftFirst = 0;
+    rootNode.triCount = tris.size();
+
+    int bvhStartIndex = allBVHNodes.size();
+    allBVHNodes.push_back(rootNode);
+
+    UpdateNodeBounds(bvhStartIndex, allBVHNodes, tris);
+    Subdivide(bvhStartIndex, allBVHNodes, tris);
+
+    // --- ОБЪЕДИНЯЕМ ---
+    int globalTriOffset = allTriangles.size();
+
+    // Сдвигаем индексы треугольников в узлах
+    for (size_t i = bvhStartIndex; i < allBVHNodes.size(); i++) {
+        if (allBVHNodes[i].triCount > 0) {
+            allBVHNodes[i].leftFirst += globalTriOffset;
+        }
+    }
+
+    allTriangles.insert(allTriangles.end(), tris.begin(), tris.end());
+    if (geometrySettings.quantizePositions) {
+        for (const GPUMeshTriangle& t : tris) allQuantTriangles.push_back(QuantizeTriangle(t, qMin, qMax));
+    } else if (geometrySettings.indexedVertices) {
+        AppendIndexed(tris);
+    }
+    return bvhStartIndex;
+}
+
+// --- ТЕКСТУРЫ МАТЕРИАЛОВ ---
+// Картинка glTF в RGBA8. UV glTF считаются от верхнего левого угла, поэтому строки не переворачиваем
+bool DecodeImage(const GLTFSource& src, int imageIdx, MipLevel& out) {
+    const tinygltf::Image& image = src.model.images[imageIdx];
+
+    if (!image.image.empty() && image.width > 0 && image.height > 0 && image.component > 0) {
+        // Уже декодирована tinygltf (uri или старый путь загрузки GLB)
+        size_t pixels = (size_t)image.width * image.height;
+        int bytesPerComponent = image.bits == 16 ? 2 : 1;
+        if (image.image.size() < pixels * image.component * bytesPerComponent) return false;
+
+        out.width = image.width;
+        out.height = image.height;
+        out.pixels.resize(pixels * 4);
+        for (size_t i = 0; i < pixels; i++) {
+            unsigned char c[4] = {0, 0, 0, 255};
+            for (int k = 0; k < std::min(image.component, 4); k++) {
+                // У 16-битных берём старший байт (little-endian)
+                c[k] = image.image[(i * image.component + k) * bytesPerComponent + bytesPerComponent - 1];
+            }
+            if (image.component <= 2) { c[3] = image.component == 2 ? c[1] : 255; c[1] = c[2] = c[0]; }
+            std::memcpy(&out.pixels[i * 4], c, 4);
+        }
+        return true;
+    }
+
+    // Картинка внутри BIN-чанка: декодируем прямо из отображения
+    int view = imageIdx < (int)src.glbImageViews.size() ? src.glbImageViews[imageIdx] : image.bufferView;
+    if (view < 0 || view >= (int)src.model.bufferViews.size()) return false;
+    const tinygltf::BufferView& bufferView = src.model.bufferViews[view];
+    const unsigned char* bytes = src.buffers[bufferView.buffer] + bufferView.byteOffset;
+
+    stbi_set_flip_vertically_on_load_thread(0);
+    int w, h, ch;
+    unsigned char* data = stbi_load_from_memory(bytes, (int)bufferView.byteLength, &w, &h, &ch, 4);
+    if (!data) return false;
+    out.width = w;
+    out.height = h;
+    out.pixels.assign(data, data + (size_t)w * h * 4);
+    stbi_image_free(data);
+    return true;
+}
+
+// Заводит GPUMaterial на каждый материал модели и декодирует их base color картинки на всех ядрах
+void LoadMaterials(const GLTFSource& src, CollectState& state) {
+    const tinygltf::Model& model = src.model;
+    state.materialBase = (int)allMaterials.size();
+    state.materialTexCoord.assign(model.materials.size(), -1);
+
+    // Одна картинка может быть у нескольких материалов - декодируем её один раз
+    std::map<int, int> imageSlot;
+    std::vector<int> imagesToDecode;
+    std::vector<int> materialImage(model.materials.size(), -1);
+    for (size_t m = 0; m < model.materials.size(); m++) {
+        const tinygltf::TextureInfo& info = model.materials[m].pbrMetallicRoughness.baseColorTexture;
+        if (info.index < 0 || info.index >= (int)model.textures.size()) continue;
+        int source = model.textures[info.index].source;
+        if (source < 0 || source >= (int)model.images.size()) continue;
+
+        auto it = imageSlot.find(source);
+        if (it == imageSlot.end()) {
+            it = imageSlot.emplace(source, (int)imagesToDecode.size()).first;
+            imagesToDecode.push_back(source);
+        }
+        materialImage[m] = it->second;
+        state.materialTexCoord[m] = info.texCoord;
+    }
+
+    std::vector<MipLevel> decoded(imagesToDecode.size());
+    std::vector<char> ok(imagesToDecode.size(), 0);
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < imagesToDecode.size(); i = next++) {
+            ok[i] = DecodeImage(src, imagesToDecode[i], decoded[i]);
+            // Слишком большие картинки уменьшаем вдвое, пока не влезут в слой
+            while (ok[i] && (decoded[i].width > geometrySettings.maxMaterialTextureSize || decoded[i].height > geometrySettings.maxMaterialTextureSize)) {
+                MipLevel smaller;
+                DownsampleBox(decoded[i], smaller);
+                decoded[i] = std::move(smaller);
+            }
+        }
+    };
+    size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), imagesToDecode.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) threads.emplace_back(worker);
+    if (!imagesToDecode.empty()) worker();
+    for (std::thread& th : threads) th.join();
+
+    std::vector<int> layerOf(imagesToDecode.size(), -1);
+    for (size_t i = 0; i < imagesToDecode.size(); i++) {
+        if (!ok[i]) {
+            std::cout << "  Failed to decode image " << imagesToDecode[i] << std::endl;
+            continue;
+        }
+        layerOf[i] = (int)materialImages.size();
+        materialImages.push_back(std::move(decoded[i]));
+    }
+
+    for (size_t m = 0; m < model.materials.size(); m++) {
+        GPUMaterial mat{};
+        mat.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        mat.textureLayer = materialImage[m] >= 0 ? layerOf[materialImage[m]] : -1;
+        if (mat.textureLayer < 0) state.materialTexCoord[m] = -1;
+        allMaterials.push_back(mat);
+    }
+}
+
+// Корзина по большей стороне картинки
+int MaterialBucket(const MipLevel& img) {
+    int size = std::max(img.width, img.height);
+    int bucket = 0;
+    while (bucket + 1 < MATERIAL_TEX_BUCKETS && size > (MATERIAL_TEX_MIN_BUCKET << bucket)) bucket++;
+    return bucket;
+}
+
+std::vector<MaterialLayers> PackMaterialLayers() {
+    std::vector<MaterialLayers> buckets(MATERIAL_TEX_BUCKETS);
+    std::vector<int> bucketOf(materialImages.size()), layerOf(materialImages.size());
+    for (size_t i = 0; i < materialImages.size(); i++) {
+        const MipLevel& img = materialImages[i];
+        bucketOf[i] = MaterialBucket(img);
+        MaterialLayers& bucket = buckets[bucketOf[i]];
+        layerOf[i] = bucket.layerCount++;
+        bucket.layerSize = std::max(bucket.layerSize, std::max(img.width, img.height));
+    }
+    for (MaterialLayers& bucket : buckets) {
+        bucket.pixels.resize((size_t)bucket.layerSize * bucket.layerSize * 4 * bucket.layerCount);
+    }
+
+    // Картинка в левом верхнем углу слоя, остаток забиваем крайними пикселями, чтобы билинейка и мипы не тянули мусор
+    for (size_t i = 0; i < materialImages.size(); i++) {
+        const MipLevel& img = materialImages[i];
+        MaterialLayers& bucket = buckets[bucketOf[i]];
+        const int layerSize = bucket.layerSize;
+        unsigned char* dst = bucket.pixels.data() + (size_t)layerSize * layerSize * 4 * layerOf[i];
+        for (int y = 0; y < layerSize; y++) {
+            const unsigned char* srcRow = img.pixels.data() + (size_t)std::min(y, img.height - 1) * img.width * 4;
+            unsigned char* dstRow = dst + (size_t)y * layerSize * 4;
+            std::memcpy(dstRow, srcRow, (size_t)img.width * 4);
+            for (int x = img.width; x < layerSize; x++) std::memcpy(dstRow + x * 4, srcRow + (img.width - 1) * 4, 4);
+        }
+    }
+
+    for (GPUMaterial& mat : allMaterials) {
+        if (mat.textureLayer < 0) continue;
+        int image = mat.textureLayer;
+        const MipLevel& img = materialImages[image];
+        const float layerSize = (float)buckets[bucketOf[image]].layerSize;
+        mat.textureLayer = layerOf[image];
+        mat.textureBucket = bucketOf[image];
+        mat.textureSize = glm::vec2((float)img.width, (float)img.height);
+        mat.uvRect = glm::vec4(0.0f, 0.0f, (float)img.width / layerSize, (float)img.height / layerSize);
+    }
+
+    materialImages.clear();
+    materialImages.shrink_to_fit();
+    return buckets;
+}
+
 void LoadGLTF(const std::string& filename, glm::vec3 offset, float scale) {
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
+    // Картинки glTF не переворачиваем (флаг stb потоковый, в этом потоке его могли включить для других текстур)
+    stbi_set_flip_vertically_on_load_thread(0);
+
+    GLTFSource src;
     std::string err, warn;
     bool ret = false;
 
-    if (filename.find(".glb") != std::string::npos) ret = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
-    else ret = loader.LoadASCIIFromFile(&model, &err, &warn, filename);
+    if (filename.find(".glb") != std::string::npos) {
+        ret = LoadGLBMapped(filename, src, err, warn);
+        if (!ret) {
+            // Старый путь через tinygltf, если отображение не получилось
+            std::cout << "GLB mmap path failed (" << err << "), fallback to tinygltf" << std::endl;
+            // Указатели в buffers могли остаться на отображение (отказ после их заполнения) - сбрасываем
+            // вместе с ним, ниже они заполнятся заново из буферов tinygltf
+            src.buffers.clear();
+            src.file.close();
+            src.model = tinygltf::Model();
+            src.glbImageViews.clear();
+            err.clear();
+            tinygltf::TinyGLTF loader;
+            ret = loader.LoadBinaryFromFile(&src.model, &err, &warn, filename);
+        }
+    } else {
+        tinygltf::TinyGLTF loader;
+        ret = loader.LoadASCIIFromFile(&src.model, &err, &warn, filename);
+    }
 
     if (!ret) { std::cout << "Failed: " << filename << std::endl; return; }
 
+    if (src.buffers.empty()) {
+        for (const tinygltf::Buffer& buffer : src.model.buffers) src.buffers.push_back(buffer.data.data());
+    }
+
     std::vector<GPUMeshTriangle> localTris;
+    std::vector<GPUTriangleAttrib> localAttribs;
 
     glm::mat4 rootTransform = glm::mat4(1.0f);
     rootTransform = glm::translate(rootTransform, offset);
     rootTransform = glm::scale(rootTransform, glm::vec3(scale));
 
-    const tinygltf::Scene& scene = model.scenes[model.defaultScene > -1 ? model.defaultScene : 0];
+    CollectState state;
+    LoadMaterials(src, state);
+    const tinygltf::Scene& scene = src.model.scenes[src.model.defaultScene > -1 ? src.model.defaultScene : 0];
     for (int nodeIndex : scene.nodes) {
-        ProcessNode(model, model.nodes[nodeIndex], rootTransform, localTris);
+        CollectPrimitives(src, src.model.nodes[nodeIndex], rootTransform, state);
     }
+    FlattenScene(src, state, localTris, localAttribs);
+    state = CollectState();
+
+    // Геометрия уже в localTris - отпускаем отображение и модель ещё до постройки BVH
+    src.file.close();
+    src.buffers.clear();
+    src.model = tinygltf::Model();
 
     if (localTris.empty()) return;
 
+    // Атрибуты общие для всех LOD-уровней: переводим индексы в глобальные до упрощения
+    int32_t attribBase = (int32_t)allTriangleAttribs.size();
+    for (GPUMeshTriangle& t : localTris) {
+        if (t.attribId >= 0) t.attribId += attribBase;
+    }
+    allTriangleAttribs.insert(allTriangleAttribs.end(), localAttribs.begin(), localAttribs.end());
+    localAttribs.clear();
+    localAttribs.shrink_to_fit();
+
+    // --- КВАНТОВАНИЕ ---
+    // Сетка строится по AABB полного меша, LOD-уровни снапаются в неё же
+    glm::vec3 qMin(1e9f), qMax(-1e9f);
+    for (const GPUMeshTriangle& t : localTris) {
+        qMin = glm::min(qMin, glm::min(t.v0, glm::min(t.v1, t.v2)));
+        qMax = glm::max(qMax, glm::max(t.v0, glm::max(t.v1, t.v2)));
+    }
+    if (geometrySettings.quantizePositions) SnapTriangles(localTris, qMin, qMax);
+
     // --- СТРОИМ BVH ---
-    GPUBVHNode rootNode;
-    rootNode.leftFirst = 0;
-    rootNode.triCount = localTris.size();
-    
-    int bvhStartIndex = allBVHNodes.size(); 
-    allBVHNodes.push_back(rootNode);
-    
-    UpdateNodeBounds(bvhStartIndex, allBVHNodes, localTris);
-    Subdivide(bvhStartIndex, allBVHNodes, localTris);
+    size_t fullTriCount = localTris.size();
+    std::vector<MeshLOD> lods;
+    int bvhStartIndex = allBVHNodes.size();
+    lods.push_back({AppendMeshBVH(localTris, qMin, qMax), (int)fullTriCount});
 
-    // --- ОБЪЕДИНЯЕМ ---
-    int globalTriOffset = allTriangles.size();
-    
-    // Сдвигаем индексы треугольников в узлах
-    for (size_t i = bvhStartIndex; i < allBVHNodes.size(); i++) {
-        if (allBVHNodes[i].triCount > 0) {
-            allBVHNodes[i].leftFirst += globalTriOffset;
+    // --- LOD ---
+    // Каждый уровень получает свой BVH, а в объекте потом просто меняется корень
+    if (lodSettings.enabled && fullTriCount > lodSettings.interactiveBudget) {
+        // Каждый следующий уровень упрощаем из предыдущего, так быстрее
+        std::vector<GPUMeshTriangle> levelTris = std::move(localTris);
+
+        for (int level = 1; level <= lodSettings.maxLevels; level++) {
+            size_t target = (size_t)(levelTris.size() * lodSettings.levelRatio);
+            std::vector<GPUMeshTriangle> simplified = SimplifyMesh(levelTris, target);
+            if (simplified.empty() || simplified.size() >= levelTris.size()) break;
+            if (geometrySettings.quantizePositions) SnapTriangles(simplified, qMin, qMax);
+
+            levelTris = simplified;
+            lods.push_back({AppendMeshBVH(simplified, qMin, qMax), (int)levelTris.size()});
+            std::cout << "  LOD " << level << ": " << levelTris.size() << " tris" << std::endl;
+
+            if (levelTris.size() <= lodSettings.interactiveBudget) break;
         }
     }
 
-    allTriangles.insert(allTriangles.end(), localTris.begin(), localTris.end());
-
     GPUMeshObject obj;
-    obj.minAABB = allBVHNodes[bvhStartIndex].minBounds;
-    obj.maxAABB = allBVHNodes[bvhStartIndex].maxBounds;
-    obj.bvhRootIndex = bvhStartIndex;
-    
+    obj.minAABB = glm::vec3(1e9f);
+    obj.maxAABB = glm::vec3(-1e9f);
+    for (const MeshLOD& lod : lods) {
+        obj.minAABB = glm::min(obj.minAABB, allBVHNodes[lod.bvhRootIndex].minBounds);
+        obj.maxAABB = glm::max(obj.maxAABB, allBVHNodes[lod.bvhRootIndex].maxBounds);
+    }
+    if (geometrySettings.quantizePositions) {
+        // Шейдер распаковывает вершины относительно AABB объекта - он должен совпадать с сеткой
+        obj.minAABB = qMin;
+        obj.maxAABB = qMax;
+    }
+    obj.bvhRootIndex = lods[0].bvhRootIndex;
+
     allObjects.push_back(obj);
+    allMeshLODs.push_back(lods);
 
-    std::cout << "Loaded: " << filename << " | Nodes: " << (allBVHNodes.size() - bvhStartIndex) << std::endl;
+    std::cout << "Loaded: " << filename << " | Nodes: " << (allBVHNodes.size() - bvhStartIndex) << " | LODs: " << lods.size() << std::endl;
+}
+
+void ClearScene() {
+    allTriangles.clear();
+    allQuantTriangles.clear();
+    allVertices.clear();
+    allIndexedTriangles.clear();
+    allTriangleAttribs.clear();
+    allMaterials.clear();
+    materialImages.clear();
+    allBVHNodes.clear();
+    allObjects.clear();
+    allMeshLODs.clear();
+}
+
+// Синтетический glTF в памяти: sparse-аксессоры поверх ненулевой базы (float и нормализованный ushort)
+// и без bufferView (база - нули). Результат ридера сверяем с ожидаемым поэлементно
+bool RunLoaderSelfTest() {
+    GLTFSource src;
+    tinygltf::Model& model = src.model;
+
+    auto addView = [&](const void* bytes, size_t size) {
+        tinygltf::Buffer buffer;
+        buffer.data.assign((const unsigned char*)bytes, (const unsigned char*)bytes + size);
+        model.buffers.push_back(buffer);
+        tinygltf::BufferView view;
+        view.buffer = (int)model.buffers.size() - 1;
+        view.byteLength = size;
+        model.bufferViews.push_back(view);
+        return (int)model.bufferViews.size() - 1;
+    };
+
+    const float baseFloats[12] = { 1, 2, 3,  4, 5, 6,  7, 8, 9,  10, 11, 12 };
+    const uint16_t baseShorts[8] = { 65535, 0,  32768, 65535,  0, 65535,  13107, 52428 };
+    const uint8_t sparseIndices[2] = { 1, 3 };
+    const float sparseFloats[6] = { -1, -2, -3,  -4, -5, -6 };
+    const uint16_t sparseShorts[4] = { 0, 65535,  65535, 0 };
+
+    int baseFloatView = addView(baseFloats, sizeof(baseFloats));
+    int baseShortView = addView(baseShorts, sizeof(baseShorts));
+    int indexView = addView(sparseIndices, sizeof(sparseIndices));
+    int sparseFloatView = addView(sparseFloats, sizeof(sparseFloats));
+    int sparseShortView = addView(sparseShorts, sizeof(sparseShorts));
+    for (const auto& buffer : model.buffers) src.buffers.push_back(buffer.data.data());
+
+    auto makeSparse = [&](int baseView, int valueView, int componentType, int type, bool normalized) {
+        tinygltf::Accessor accessor;
+        accessor.bufferView = baseView;
+        accessor.componentType = componentType;
+        accessor.type = type;
+        accessor.normalized = normalized;
+        accessor.count = 4;
+        accessor.sparse.isSparse = true;
+        accessor.sparse.count = 2;
+        accessor.sparse.indices.bufferView = indexView;
+        accessor.sparse.indices.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+        accessor.sparse.values.bufferView = valueView;
+        return accessor;
+    };
+
+    struct Case {
+        const char* name;
+        tinygltf::Accessor accessor;
+        std::vector<float> expected;
+    };
+    std::vector<Case> cases = {
+        { "float VEC3 over base",
+          makeSparse(baseFloatView, sparseFloatView, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, false),
+          { 1, 2, 3,  -1, -2, -3,  7, 8, 9,  -4, -5, -6 } },
+        { "normalized ushort VEC2 over base",
+          makeSparse(baseShortView, sparseShortView, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_VEC2, true),
+          { 1.0f, 0.0f,  0.0f, 1.0f,  0.0f, 1.0f,  1.0f, 0.0f } },
+        { "float VEC3 without bufferView",
+          makeSparse(-1, sparseFloatView, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, false),
+          { 0, 0, 0,  -1, -2, -3,  0, 0, 0,  -4, -5, -6 } },
+    };
+
+    bool ok = true;
+    for (const Case& test : cases) {
+        AccessorReader r = MakeAccessorReader(src, test.accessor);
+        int mismatches = 0;
+        for (size_t i = 0; i < test.expected.size(); i++) {
+            float got = r.component(i / r.components, (int)(i % r.components));
+            if (std::abs(got - test.expected[i]) > 1e-5f) mismatches++;
+        }
+        std::cout << (mismatches == 0 ? "PASS " : "FAIL ") << test.name << " | mismatches: " << mismatches << std::endl;
+        ok = ok && mismatches == 0;
+    }
+    return ok;
 }
 
 void CreateTestPyramid() {
     int startIndex = allTriangles.size();
     
     GPUMeshTriangle t; 
+    t.attribId = -1;
 
     t.color = glm::vec3(0.0f, 0.8f, 0.2f);
     t.v0 = glm::vec3(-1, 0, -3); 
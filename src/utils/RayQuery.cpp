@@ -0,0 +1,466 @@
+#include "RayQuery.h"
+#include "BVH.h"
+#include "ModelLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+float IntersectAABB(const glm::vec3& ro, const glm::vec3& invRd, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    glm::vec3 tMin = (boxMin - ro) * invRd;
+    glm::vec3 tMax = (boxMax - ro) * invRd;
+    glm::vec3 t1 = glm::min(tMin, tMax);
+    glm::vec3 t2 = glm::max(tMin, tMax);
+    float tNear = std::fmax(std::fmax(t1.x, t1.y), t1.z);
+    float tFar = std::fmin(std::fmin(t2.x, t2.y), t2.z);
+    return (tNear <= tFar && tFar > 0.0f) ? tNear : 1e30f;
+}
+
+float IntersectTriangle(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2, glm::vec2& bary) {
+    glm::vec3 v0v1 = v1 - v0;
+    glm::vec3 v0v2 = v2 - v0;
+    glm::vec3 pvec = glm::cross(rd, v0v2);
+    float det = glm::dot(v0v1, pvec);
+    if (std::fabs(det) < 0.00001f) return 1e10f;
+    float invDet = 1.0f / det;
+    glm::vec3 tvec = ro - v0;
+    float u = glm::dot(tvec, pvec) * invDet;
+    if (u < 0.0f || u > 1.0f) return 1e10f;
+    glm::vec3 qvec = glm::cross(tvec, v0v1);
+    float v = glm::dot(rd, qvec) * invDet;
+    if (v < 0.0f || u + v > 1.0f) return 1e10f;
+    float t = glm::dot(v0v2, qvec) * invDet;
+    bary = glm::vec2(u, v);
+    return (t > 0.001f) ? t : 1e10f;
+}
+
+glm::vec3 IndexedVertex(uint32_t i) {
+    return glm::vec3(allVertices[3 * i], allVertices[3 * i + 1], allVertices[3 * i + 2]);
+}
+
+// Как fetchTriangle в шейдере: вершины для любого формата геометрии
+void FetchTriangle(int format, int triIdx, const glm::vec3& qMin, const glm::vec3& qScale, glm::vec3& v0, glm::vec3& v1, glm::vec3& v2) {
+    if (format == GEOMETRY_INDEXED) {
+        const GPUIndexedTriangle& it = allIndexedTriangles[triIdx];
+        v0 = IndexedVertex(it.i0); v1 = IndexedVertex(it.i1); v2 = IndexedVertex(it.i2);
+    } else if (format == GEOMETRY_QUANTIZED) {
+        const GPUQuantTriangle& q = allQuantTriangles[triIdx];
+        v0 = qMin + glm::vec3(q.p0 & 0xFFFFu, q.p0 >> 16, q.p1 & 0xFFFFu) * qScale;
+        v1 = qMin + glm::vec3(q.p1 >> 16, q.p2 & 0xFFFFu, q.p2 >> 16) * qScale;
+        v2 = qMin + glm::vec3(q.p3 & 0xFFFFu, q.p3 >> 16, q.p4 & 0xFFFFu) * qScale;
+    } else {
+        const GPUMeshTriangle& tri = allTriangles[triIdx];
+        v0 = tri.v0; v1 = tri.v1; v2 = tri.v2;
+    }
+}
+
+// Обход BVH одного объекта, как traverseMeshBVH в шейдере: ближний ребёнок первым, дальний - в короткий стек
+// вместе с расстоянием до его AABB. Бит уровня в trail - ближний ребёнок на этом уровне пройден;
+// если нужной записи в стеке нет (вытеснена), спускаемся заново от корня по trail (restart trail).
+// AnyHit - выход на первом пересечении ближе tMax
+template <bool AnyHit, int StackSize = 8>
+bool TraverseMesh(const glm::vec3& ro, const glm::vec3& rd, const glm::vec3& invRd, int objId, int format, float& tMax, int& hitTri, glm::vec2& hitBary) {
+    const GPUMeshObject& obj = allObjects[objId];
+    glm::vec3 qMin = obj.minAABB;
+    glm::vec3 qScale = (obj.maxAABB - qMin) / 65535.0f;
+    hitTri = -1;
+
+    int stackNode[StackSize] = {};
+    float stackDist[StackSize] = {};
+    uint32_t stackLevel[StackSize] = {};
+    int stackTop = 0, stackSize = 0; // Кольцевой буфер, при переполнении теряются самые старые записи
+
+    int nodeIdx = obj.bvhRootIndex;
+    uint32_t level = 0x80000000u; // Бит уровня детей текущего узла
+    uint32_t trail = 0;
+
+    while (true) {
+        const GPUBVHNode& node = allBVHNodes[nodeIdx];
+        if (node.triCount > 0) {
+            for (int i = 0; i < node.triCount; i++) {
+                int triIdx = node.leftFirst + i;
+                glm::vec3 v0, v1, v2;
+                FetchTriangle(format, triIdx, qMin, qScale, v0, v1, v2);
+                glm::vec2 bary;
+                float t = IntersectTriangle(ro, rd, v0, v1, v2, bary);
+                if (t < tMax) {
+                    tMax = t;
+                    hitTri = triIdx;
+                    hitBary = bary;
+                    if (AnyHit) return true;
+                }
+            }
+        } else {
+            int left = node.leftFirst;
+            float dl = IntersectAABB(ro, invRd, allBVHNodes[left].minBounds, allBVHNodes[left].maxBounds);
+            float dr = IntersectAABB(ro, invRd, allBVHNodes[left + 1].minBounds, allBVHNodes[left + 1].maxBounds);
+            bool hl = dl < tMax, hr = dr < tMax;
+            if (hl || hr) {
+                if (hl && hr) {
+                    int nearIdx = dl <= dr ? left : left + 1;
+                    int farIdx = 2 * left + 1 - nearIdx;
+                    if (trail & level) {
+                        nodeIdx = farIdx;
+                    } else {
+                        nodeIdx = nearIdx;
+                        stackNode[stackTop] = farIdx;
+                        stackDist[stackTop] = std::fmax(dl, dr);
+                        stackLevel[stackTop] = level;
+                        stackTop = (stackTop + 1) % StackSize;
+                        stackSize = std::min(stackSize + 1, StackSize);
+                    }
+                } else {
+                    nodeIdx = hl ? left : left + 1;
+                    trail |= level;
+                }
+                level >>= 1;
+                continue;
+            }
+        }
+
+        // Поддерево закончено: отмечаем в trail и переходим к следующему дальнему ребёнку
+        while (true) {
+            uint32_t entered = level << 1;
+            if (entered == 0) return hitTri >= 0;     // Корень
+            trail &= ~(entered - 1);
+            trail += entered;
+            if (trail == 0) return hitTri >= 0;       // Перенос ушёл за корень - дерево пройдено
+            uint32_t popLevel = trail & (~trail + 1); // Младший установленный бит
+            level = popLevel >> 1;
+
+            int top = (stackTop + StackSize - 1) % StackSize;
+            if (stackSize > 0 && stackLevel[top] == popLevel) {
+                stackTop = top;
+                stackSize--;
+                if (stackDist[top] >= tMax) continue; // Дальний ребёнок дальше найденного - сразу закрываем
+                nodeIdx = stackNode[top];
+            } else {
+                stackSize = 0;
+                nodeIdx = obj.bvhRootIndex;
+                level = 0x80000000u;
+            }
+            break;
+        }
+    }
+}
+
+// Пол - квадрат floorSize на y = -1
+bool HitFloor(const glm::vec3& ro, const glm::vec3& rd, float floorSize, float tLimit, float& t) {
+    float tp = -(ro.y + 1.0f) / rd.y;
+    if (!(tp > 0.001f && tp < tLimit)) return false;
+    glm::vec3 p = ro + rd * tp;
+    if (std::fabs(p.x) >= floorSize || std::fabs(p.z) >= floorSize) return false;
+    t = tp;
+    return true;
+}
+
+// Ближайшее пересечение и any-hit по всей сцене. StackSize - только для сверки в RunRayQueryBenchmark,
+// сцена и шейдер обходятся со стеком 8
+template <int StackSize>
+bool TraceClosestStack(const glm::vec3& ro, const glm::vec3& rd, int geometryFormat, float floorSize, RayHit& hit) {
+    bool found = false;
+    float tp;
+    if (HitFloor(ro, rd, floorSize, hit.t, tp)) {
+        hit.t = tp;
+        hit.objId = 10;
+        hit.triIdx = -1;
+        found = true;
+    }
+
+    glm::vec3 invRd = 1.0f / rd;
+    for (int i = 0; i < (int)allObjects.size(); i++) {
+        if (IntersectAABB(ro, invRd, allObjects[i].minAABB, allObjects[i].maxAABB) < hit.t) {
+            int triIdx;
+            glm::vec2 bary;
+            if (TraverseMesh<false, StackSize>(ro, rd, invRd, i, geometryFormat, hit.t, triIdx, bary)) {
+                hit.objId = i;
+                hit.triIdx = triIdx;
+                hit.bary = bary;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+template <int StackSize>
+bool TraceOccludedStack(const glm::vec3& ro, const glm::vec3& rd, float maxT, int geometryFormat, float floorSize) {
+    float tp;
+    if (HitFloor(ro, rd, floorSize, maxT, tp)) return true;
+
+    glm::vec3 invRd = 1.0f / rd;
+    for (int i = 0; i < (int)allObjects.size(); i++) {
+        float t = maxT;
+        int triIdx;
+        glm::vec2 bary;
+        if (IntersectAABB(ro, invRd, allObjects[i].minAABB, allObjects[i].maxAABB) < maxT &&
+            TraverseMesh<true, StackSize>(ro, rd, invRd, i, geometryFormat, t, triIdx, bary)) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+bool TraceClosest(const glm::vec3& ro, const glm::vec3& rd, int geometryFormat, float floorSize, RayHit& hit) {
+    return TraceClosestStack<8>(ro, rd, geometryFormat, floorSize, hit);
+}
+
+bool TraceOccluded(const glm::vec3& ro, const glm::vec3& rd, float maxT, int geometryFormat, float floorSize) {
+    return TraceOccludedStack<8>(ro, rd, maxT, geometryFormat, floorSize);
+}
+
+namespace {
+
+// Все треугольники полного уровня объекта: листья BVH без отсечения по лучу
+void CollectTriangles(int nodeIdx, std::vector<int>& out) {
+    const GPUBVHNode& node = allBVHNodes[nodeIdx];
+    if (node.triCount > 0) {
+        for (int i = 0; i < node.triCount; i++) out.push_back(node.leftFirst + i);
+        return;
+    }
+    CollectTriangles(node.leftFirst, out);
+    CollectTriangles(node.leftFirst + 1, out);
+}
+
+// Эталон: ближайшее пересечение перебором, тем же тестом треугольника
+float BruteClosest(const glm::vec3& ro, const glm::vec3& rd, int format, float floorSize, const std::vector<std::vector<int>>& objectTris, int& objId) {
+    float best = 1e10f;
+    objId = -1;
+    float tp;
+    if (HitFloor(ro, rd, floorSize, best, tp)) { best = tp; objId = 10; }
+    for (int i = 0; i < (int)allObjects.size(); i++) {
+        glm::vec3 qMin = allObjects[i].minAABB;
+        glm::vec3 qScale = (allObjects[i].maxAABB - qMin) / 65535.0f;
+        for (int triIdx : objectTris[i]) {
+            glm::vec3 v0, v1, v2;
+            FetchTriangle(format, triIdx, qMin, qScale, v0, v1, v2);
+            glm::vec2 bary;
+            float t = IntersectTriangle(ro, rd, v0, v1, v2, bary);
+            if (t < best) { best = t; objId = i; }
+        }
+    }
+    return best;
+}
+
+template <typename F>
+double SecondsOf(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Лучи сверки и ответы перебора для них
+struct RayBatch {
+    int format;
+    float floorSize;
+    std::vector<glm::vec3> origins, dirs;
+    std::vector<float> occlusionT, bruteT;
+};
+
+// Лучи снаружи области в случайную точку внутри: почти все доходят до BVH, часть промахивается мимо геометрии
+RayBatch MakeRayBatch(int format, float floorSize, int rayCount, const glm::vec3& boxMin, const glm::vec3& boxMax, const std::vector<std::vector<int>>& objectTris) {
+    RayBatch batch;
+    batch.format = format;
+    batch.floorSize = floorSize;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec3 center = 0.5f * (boxMin + boxMax);
+    float radius = glm::length(boxMax - boxMin) + 1.0f;
+    for (int r = 0; r < rayCount; r++) {
+        float z = 1.0f - 2.0f * unit(rng), phi = 6.2831853f * unit(rng), s = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        glm::vec3 origin = center + radius * glm::vec3(s * std::cos(phi), z, s * std::sin(phi));
+        glm::vec3 target = boxMin + (boxMax - boxMin) * glm::vec3(unit(rng), unit(rng), unit(rng));
+        batch.origins.push_back(origin);
+        batch.dirs.push_back(glm::normalize(target - origin));
+        batch.occlusionT.push_back(radius * 2.0f * unit(rng));
+        int objId;
+        batch.bruteT.push_back(BruteClosest(origin, batch.dirs.back(), format, floorSize, objectTris, objId));
+    }
+    return batch;
+}
+
+struct StackRun {
+    int closestMismatch = 0, occludedMismatch = 0;
+    double closestSec = 0.0, occludedSec = 0.0;
+};
+
+// Сверка с перебором и замер обходов со стеком StackSize. Маленький стек переполняется и чаще
+// уходит в restart trail - ответы от этого меняться не должны
+template <int StackSize>
+StackRun RunStack(const RayBatch& batch) {
+    StackRun run;
+    int rayCount = (int)batch.origins.size();
+    for (int r = 0; r < rayCount; r++) {
+        RayHit hit;
+        TraceClosestStack<StackSize>(batch.origins[r], batch.dirs[r], batch.format, batch.floorSize, hit);
+        // Одинаковый t у разных объектов возможен только на стыке - сравниваем расстояние, а не объект
+        float bruteT = batch.bruteT[r];
+        bool bothMiss = bruteT >= 1e10f && hit.t >= 1e10f;
+        if (!bothMiss && std::fabs(hit.t - bruteT) > 1e-5f * std::max(1.0f, bruteT)) run.closestMismatch++;
+
+        bool expected = bruteT < batch.occlusionT[r];
+        if (TraceOccludedStack<StackSize>(batch.origins[r], batch.dirs[r], batch.occlusionT[r], batch.format, batch.floorSize) != expected) run.occludedMismatch++;
+    }
+
+    volatile float sink = 0.0f;
+    run.closestSec = SecondsOf([&]() {
+        for (int r = 0; r < rayCount; r++) {
+            RayHit hit;
+            TraceClosestStack<StackSize>(batch.origins[r], batch.dirs[r], batch.format, batch.floorSize, hit);
+            sink = sink + hit.t;
+        }
+    });
+    run.occludedSec = SecondsOf([&]() {
+        for (int r = 0; r < rayCount; r++) {
+            sink = sink + (TraceOccludedStack<StackSize>(batch.origins[r], batch.dirs[r], batch.occlusionT[r], batch.format, batch.floorSize) ? 1.0f : 0.0f);
+        }
+    });
+    return run;
+}
+
+// Стек 8 - как в шейдере, 1 и 2 - чтобы restart trail работал почти на каждом узле. false - есть расхождения
+bool ReportStacks(const RayBatch& batch) {
+    const struct { int size; StackRun run; } runs[] = {
+        { 8, RunStack<8>(batch) },
+        { 2, RunStack<2>(batch) },
+        { 1, RunStack<1>(batch) },
+    };
+    bool match = true;
+    double rays = (double)batch.origins.size();
+    for (const auto& r : runs) {
+        std::cout << std::fixed << std::setprecision(3)
+                  << "           stack " << r.size << ": mismatches closest " << r.run.closestMismatch << ", occluded " << r.run.occludedMismatch
+                  << " | closest " << rays / r.run.closestSec / 1e6 << " Mrays/s"
+                  << " | occluded " << rays / r.run.occludedSec / 1e6 << " Mrays/s" << std::defaultfloat << std::endl;
+        if (r.run.closestMismatch > 0 || r.run.occludedMismatch > 0) match = false;
+    }
+    return match;
+}
+
+// Вырожденное дерево предельной глубины MAX_BVH_DEPTH: у каждого внутреннего узла один ребёнок - лист
+// с треугольником в плоскости x = k, другой - следующий внутренний узел. Стек переполняется на каждом
+// луче вдоль цепочки, а биты уровней trail используются все
+void BuildDegenerateScene() {
+    ClearScene();
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> side(-2.0f, 2.0f);
+    const int leaves = MAX_BVH_DEPTH + 1;
+    for (int k = 0; k < leaves; k++) {
+        GPUMeshTriangle t{};
+        t.attribId = -1;
+        t.v0 = glm::vec3((float)k, side(rng), side(rng));
+        t.v1 = glm::vec3((float)k, side(rng), side(rng));
+        t.v2 = glm::vec3((float)k, side(rng), side(rng));
+        allTriangles.push_back(t);
+    }
+
+    auto leafNode = [](int k) {
+        const GPUMeshTriangle& t = allTriangles[k];
+        GPUBVHNode node{};
+        node.minBounds = glm::min(glm::min(t.v0, t.v1), t.v2);
+        node.maxBounds = glm::max(glm::max(t.v0, t.v1), t.v2);
+        node.leftFirst = k;
+        node.triCount = 1;
+        return node;
+    };
+
+    // Узел k покрывает треугольники k..leaves-1; листья собираются с конца, чтобы границы были готовы
+    std::vector<GPUBVHNode> chain(leaves);
+    chain[leaves - 1] = leafNode(leaves - 1);
+    for (int k = leaves - 2; k >= 0; k--) {
+        GPUBVHNode leaf = leafNode(k);
+        chain[k].minBounds = glm::min(leaf.minBounds, chain[k + 1].minBounds);
+        chain[k].maxBounds = glm::max(leaf.maxBounds, chain[k + 1].maxBounds);
+    }
+
+    // Раскладка как у BuildBVH: корень, затем пары детей
+    allBVHNodes.push_back(chain[0]);
+    int parent = 0;
+    for (int k = 0; k < leaves - 1; k++) {
+        int left = (int)allBVHNodes.size();
+        allBVHNodes[parent].leftFirst = left;
+        allBVHNodes[parent].triCount = 0;
+        allBVHNodes.push_back(leafNode(k));
+        allBVHNodes.push_back(chain[k + 1]);
+        parent = left + 1;
+    }
+
+    GPUMeshObject obj{};
+    obj.minAABB = allBVHNodes[0].minBounds;
+    obj.maxAABB = allBVHNodes[0].maxBounds;
+    obj.bvhRootIndex = 0;
+    allObjects.push_back(obj);
+}
+
+} // namespace
+
+bool RunRayQueryBenchmark(const std::string& modelPath) {
+    const int rayCount = 20000;
+    const float floorSize = 5.0f; // Как у пола в режиме рендера
+    const struct { int format; const char* name; bool quantize, indexed; } formats[] = {
+        { GEOMETRY_FULL, "full", false, false },
+        { GEOMETRY_INDEXED, "indexed", false, true },
+        { GEOMETRY_QUANTIZED, "quantized", true, false },
+    };
+
+    bool allMatch = true;
+    GeometrySettings saved = geometrySettings;
+    for (const auto& f : formats) {
+        // Квантование снапает вершины при загрузке, так что на каждый формат - своя загрузка
+        geometrySettings.quantizePositions = f.quantize;
+        geometrySettings.indexedVertices = f.indexed;
+        ClearScene();
+        LoadGLTF(modelPath, glm::vec3(0.0f, 0.5f, 0.0f), 1.0f);
+        if (allObjects.empty()) {
+            std::cout << f.name << ": no mesh objects loaded, skipped" << std::endl;
+            continue;
+        }
+
+        std::vector<std::vector<int>> objectTris(allObjects.size());
+        glm::vec3 sceneMin(1e9f), sceneMax(-1e9f);
+        for (size_t i = 0; i < allObjects.size(); i++) {
+            CollectTriangles(allObjects[i].bvhRootIndex, objectTris[i]);
+            sceneMin = glm::min(sceneMin, allObjects[i].minAABB);
+            sceneMax = glm::max(sceneMax, allObjects[i].maxAABB);
+        }
+
+        RayBatch batch = MakeRayBatch(f.format, floorSize, rayCount, sceneMin, sceneMax, objectTris);
+        int hits = 0;
+        for (float t : batch.bruteT) if (t < 1e10f) hits++;
+
+        volatile float sink = 0.0f;
+        const int bruteRays = std::min(rayCount, 2000);
+        double bruteSec = SecondsOf([&]() {
+            for (int r = 0; r < bruteRays; r++) {
+                int objId;
+                sink = sink + BruteClosest(batch.origins[r], batch.dirs[r], f.format, floorSize, objectTris, objId);
+            }
+        });
+
+        std::cout << std::left << std::setw(10) << f.name << std::right
+                  << " tris " << allTriangles.size() << " | hits " << hits << "/" << rayCount
+                  << std::fixed << std::setprecision(3) << " | brute force " << bruteRays / bruteSec / 1e6 << " Mrays/s" << std::defaultfloat << std::endl;
+        if (!ReportStacks(batch)) allMatch = false;
+    }
+
+    // floorSize 0 - без пола, сверяется только дерево
+    BuildDegenerateScene();
+    std::vector<std::vector<int>> chainTris(1);
+    CollectTriangles(0, chainTris[0]);
+    RayBatch chainBatch = MakeRayBatch(GEOMETRY_FULL, 0.0f, rayCount, allObjects[0].minAABB, allObjects[0].maxAABB, chainTris);
+    int chainHits = 0;
+    for (float t : chainBatch.bruteT) if (t < 1e10f) chainHits++;
+    std::cout << std::left << std::setw(10) << "chain" << std::right << " depth " << MAX_BVH_DEPTH
+              << " | hits " << chainHits << "/" << rayCount << std::endl;
+    if (!ReportStacks(chainBatch)) allMatch = false;
+
+    geometrySettings = saved;
+    ClearScene();
+    std::cout << (allMatch ? "RayQuery matches brute force" : "RayQuery MISMATCH") << std::endl;
+    return allMatch;
+}
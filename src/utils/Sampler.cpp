@@ -0,0 +1,181 @@
+#include "Sampler.h"
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Первые четыре измерения Sobol по Joe-Kuo: степень s, коэффициенты a и начальные m.
+// Нулевое измерение - ван дер Корпут (разворот битов)
+struct SobolTable {
+    uint32_t directions[4][32];
+
+    SobolTable() {
+        for (int k = 0; k < 32; k++) directions[0][k] = 1u << (31 - k);
+
+        const int degree[3] = { 1, 2, 3 };
+        const uint32_t coeffs[3] = { 0, 1, 1 };
+        const uint32_t initial[3][3] = { { 1 }, { 1, 3 }, { 1, 3, 1 } };
+        for (int d = 0; d < 3; d++) {
+            int s = degree[d];
+            uint32_t m[32];
+            for (int k = 0; k < s; k++) m[k] = initial[d][k];
+            for (int k = s; k < 32; k++) {
+                uint32_t v = m[k - s] ^ (m[k - s] << s);
+                for (int j = 1; j < s; j++) {
+                    if ((coeffs[d] >> (s - 1 - j)) & 1u) v ^= m[k - j] << j;
+                }
+                m[k] = v;
+            }
+            for (int k = 0; k < 32; k++) directions[d + 1][k] = m[k] << (31 - k);
+        }
+    }
+};
+
+const SobolTable& Directions() {
+    static const SobolTable table;
+    return table;
+}
+
+uint32_t HashU32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint32_t HashCombine(uint32_t h, uint32_t v) {
+    return h ^ (v + (h << 6) + (h >> 2));
+}
+
+uint32_t ReverseBits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+    x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+uint32_t NestedUniformScramble(uint32_t x, uint32_t key) {
+    x = ReverseBits(x);
+    x += key;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return ReverseBits(x);
+}
+
+float SobolOwen(uint32_t index, uint32_t pixelKey, uint32_t dim) {
+    uint32_t key = HashCombine(pixelKey, HashU32(dim >> 2));
+    uint32_t shuffled = NestedUniformScramble(index, key);
+    uint32_t v = NestedUniformScramble(SobolSample(shuffled, dim & 3u), HashU32(HashCombine(key, dim & 3u)));
+    return (float)(v >> 8) / (float)0x01000000u;
+}
+
+struct BenchIntegrand {
+    const char* name;
+    int dims;
+    double reference;
+    std::function<double(const float*)> f;
+};
+
+} // namespace
+
+uint32_t SobolSample(uint32_t index, uint32_t dim) {
+    const uint32_t* directions = Directions().directions[dim & 3u];
+    uint32_t v = 0;
+    for (int bit = 0; index != 0; bit++, index >>= 1) {
+        if (index & 1u) v ^= directions[bit];
+    }
+    return v;
+}
+
+uint32_t SamplerPixelKey(uint32_t x, uint32_t y, int32_t samplerSeed) {
+    return HashU32(HashCombine(HashU32((uint32_t)samplerSeed), x | (y << 16)));
+}
+
+PathSampler::PathSampler(SamplerType type, uint32_t x, uint32_t y, const SampleSeed& seed)
+    : type(type), key(SamplerPixelKey(x, y, seed.scramble)), index((uint32_t)seed.index) {
+    state = (type == SAMPLER_SOBOL) ? 0u : x * 1973u + y * 9277u + (uint32_t)(seed.lcg.x * 1000.0f) * 26699u;
+}
+
+float PathSampler::next() {
+    if (type == SAMPLER_SOBOL) return SobolOwen(index, key, state++);
+    state = state * 1664525u + 1013904223u;
+    return (float)(state & 0x00FFFFFFu) / (float)0x01000000u;
+}
+
+void RunSamplerBenchmark() {
+    const double pi = 3.14159265358979;
+    const double gaussian1D = std::sqrt(pi / 8.0) * std::erf(std::sqrt(2.0));
+
+    // Похожие на пиксель интегралы: граница тени в 2D и 4D, гладкий блик и гладкий путь из трёх отскоков
+    const std::vector<BenchIntegrand> integrands = {
+        { "edge 2D", 2, 0.5, [](const float* u) { return u[1] > 0.3f + 0.4f * u[0] ? 1.0 : 0.0; } },
+        { "edge 4D", 4, 0.5, [](const float* u) { return u[0] + u[1] + u[2] + u[3] > 2.0f ? 1.0 : 0.0; } },
+        { "gauss 2D", 2, gaussian1D * gaussian1D, [](const float* u) {
+            double dx = u[0] - 0.5, dy = u[1] - 0.5;
+            return std::exp(-8.0 * (dx * dx + dy * dy));
+        } },
+        { "smooth 6D", 6, 1.0, [pi](const float* u) {
+            double v = 1.0;
+            for (int i = 0; i < 6; i++) v *= 0.5 * pi * std::sin(pi * u[i]);
+            return v;
+        } },
+    };
+
+    const int pixelsX = 32, pixelsY = 32;
+    const int maxSpp = 1024;
+
+    std::cout << "Sampler convergence: RMSE over " << pixelsX * pixelsY << " pixels" << std::endl;
+    std::cout << std::left << std::setw(11) << "integrand" << std::right << std::setw(6) << "spp"
+              << std::setw(12) << "LCG" << std::setw(12) << "Sobol" << std::setw(8) << "ratio" << std::endl;
+
+    for (const BenchIntegrand& integrand : integrands) {
+        std::vector<double> sqError[2];
+        for (int type = SAMPLER_LCG; type <= SAMPLER_SOBOL; type++) {
+            // u_seed1 в main.cpp берётся из rand() на каждый сэмпл, u_samplerSeed - один на накопление
+            std::mt19937 frameRandom(1234);
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            std::vector<SampleSeed> seeds(maxSpp);
+            for (int s = 0; s < maxSpp; s++) {
+                seeds[s].lcg = glm::vec2(unit(frameRandom), unit(frameRandom));
+                seeds[s].index = s;
+                seeds[s].scramble = 0x2545F491;
+            }
+
+            sqError[type].assign(maxSpp + 1, 0.0);
+            for (int y = 0; y < pixelsY; y++) {
+                for (int x = 0; x < pixelsX; x++) {
+                    double sum = 0.0;
+                    for (int s = 0; s < maxSpp; s++) {
+                        PathSampler sampler((SamplerType)type, x, y, seeds[s]);
+                        float u[8];
+                        for (int d = 0; d < integrand.dims; d++) u[d] = sampler.next();
+                        sum += integrand.f(u);
+                        int spp = s + 1;
+                        if ((spp & (spp - 1)) == 0) {
+                            double err = sum / spp - integrand.reference;
+                            sqError[type][spp] += err * err;
+                        }
+                    }
+                }
+            }
+        }
+
+        for (int spp = 1; spp <= maxSpp; spp *= 2) {
+            double lcg = std::sqrt(sqError[SAMPLER_LCG][spp] / (pixelsX * pixelsY));
+            double sobol = std::sqrt(sqError[SAMPLER_SOBOL][spp] / (pixelsX * pixelsY));
+            std::cout << std::left << std::setw(11) << integrand.name << std::right << std::setw(6) << spp
+                      << std::fixed << std::setprecision(6) << std::setw(12) << lcg << std::setw(12) << sobol
+                      << std::setprecision(1) << std::setw(7) << (sobol > 0.0 ? lcg / sobol : 0.0) << "x"
+                      << std::defaultfloat << std::endl;
+        }
+    }
+}
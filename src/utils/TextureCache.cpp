@@ -0,0 +1,317 @@
+#include "TextureCache.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+TextureCacheSettings textureCacheSettings;
+
+namespace {
+
+const uint32_t kCacheVersion = 1;
+
+size_t AlignUp(size_t v, size_t a) { return (v + a - 1) & ~(a - 1); }
+
+size_t BlockBytes(CachedFormat format) { return format == CachedFormat::BC1 ? 8 : 16; }
+
+size_t LevelBytes(CachedFormat format, int w, int h) {
+    if (format == CachedFormat::RGBA8) return (size_t)w * h * 4;
+    return (size_t)((w + 3) / 4) * ((h + 3) / 4) * BlockBytes(format);
+}
+
+// --- BC1 / BC3 ---
+
+uint16_t PackRGB565(const float c[3]) {
+    int r = std::clamp((int)(c[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+    int g = std::clamp((int)(c[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+    int b = std::clamp((int)(c[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void UnpackRGB565(uint16_t c, int out[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// Концы отрезка берём по главной оси цветов блока (несколько итераций степенного метода)
+void EncodeColorBlock(const unsigned char px[16][4], unsigned char* dst) {
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) for (int c = 0; c < 3; c++) mean[c] += px[i][c];
+    for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+    float cov[6] = {0};
+    for (int i = 0; i < 16; i++) {
+        float r = px[i][0] - mean[0], g = px[i][1] - mean[1], b = px[i][2] - mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int it = 0; it < 4; it++) {
+        float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+        float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+        float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+        float len = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+        if (len < 1e-6f) break;
+        axis[0] = x / len; axis[1] = y / len; axis[2] = z / len;
+    }
+
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (px[i][0] - mean[0]) * axis[0] + (px[i][1] - mean[1]) * axis[1] + (px[i][2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    float lo[3], hi[3];
+    for (int c = 0; c < 3; c++) {
+        lo[c] = std::clamp(mean[c] + axis[c] * tMin, 0.0f, 255.0f);
+        hi[c] = std::clamp(mean[c] + axis[c] * tMax, 0.0f, 255.0f);
+    }
+
+    uint16_t c0 = PackRGB565(hi), c1 = PackRGB565(lo);
+    if (c0 < c1) std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        // c0 > c1 - четырёхцветный режим
+        int p[4][3];
+        UnpackRGB565(c0, p[0]);
+        UnpackRGB565(c1, p[1]);
+        for (int c = 0; c < 3; c++) {
+            p[2][c] = (2 * p[0][c] + p[1][c]) / 3;
+            p[3][c] = (p[0][c] + 2 * p[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = 1 << 30;
+            for (int k = 0; k < 4; k++) {
+                int dr = px[i][0] - p[k][0], dg = px[i][1] - p[k][1], db = px[i][2] - p[k][2];
+                int d = dr*dr + dg*dg + db*db;
+                if (d < bestDist) { bestDist = d; best = k; }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+
+    dst[0] = (unsigned char)(c0 & 0xFF); dst[1] = (unsigned char)(c0 >> 8);
+    dst[2] = (unsigned char)(c1 & 0xFF); dst[3] = (unsigned char)(c1 >> 8);
+    for (int k = 0; k < 4; k++) dst[4 + k] = (unsigned char)(indices >> (8 * k));
+}
+
+void EncodeAlphaBlock(const unsigned char px[16][4], unsigned char* dst) {
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, (int)px[i][3]);
+        a1 = std::min(a1, (int)px[i][3]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        // a0 > a1 - восьмиуровневый режим
+        int p[8];
+        p[0] = a0; p[1] = a1;
+        for (int k = 1; k <= 6; k++) p[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestDist = 1 << 30;
+            for (int k = 0; k < 8; k++) {
+                int d = std::abs(px[i][3] - p[k]);
+                if (d < bestDist) { bestDist = d; best = k; }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+
+    dst[0] = (unsigned char)a0;
+    dst[1] = (unsigned char)a1;
+    for (int k = 0; k < 6; k++) dst[2 + k] = (unsigned char)(indices >> (8 * k));
+}
+
+} // namespace
+
+void CompressBC(const MipLevel& mip, CachedFormat format, std::vector<unsigned char>& out) {
+    const int bw = (mip.width + 3) / 4, bh = (mip.height + 3) / 4;
+    const size_t blockBytes = BlockBytes(format);
+    out.resize((size_t)bw * bh * blockBytes);
+
+    unsigned char px[16][4];
+    for (int by = 0; by < bh; by++) {
+        for (int bx = 0; bx < bw; bx++) {
+            // Блоки на краю дополняем повтором последнего пикселя
+            for (int y = 0; y < 4; y++) {
+                int sy = std::min(by * 4 + y, mip.height - 1);
+                for (int x = 0; x < 4; x++) {
+                    int sx = std::min(bx * 4 + x, mip.width - 1);
+                    std::memcpy(px[y * 4 + x], &mip.pixels[((size_t)sy * mip.width + sx) * 4], 4);
+                }
+            }
+            unsigned char* dst = &out[((size_t)by * bw + bx) * blockBytes];
+            if (format == CachedFormat::BC3) {
+                EncodeAlphaBlock(px, dst);
+                dst += 8;
+            }
+            EncodeColorBlock(px, dst);
+        }
+    }
+}
+
+uint64_t HashBytes(const unsigned char* data, size_t size) {
+    // FNV-1a 64
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+CachedFormat PreferredCacheFormat(bool alpha) {
+    if (!textureCacheSettings.compress || !GLAD_GL_EXT_texture_compression_s3tc) return CachedFormat::RGBA8;
+    return alpha ? CachedFormat::BC3 : CachedFormat::BC1;
+}
+
+std::string TextureCachePath(uint64_t sourceHash, bool alpha, CachedFormat format) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%c%u.ptex", (unsigned long long)sourceHash, alpha ? 'a' : 'o', (unsigned)format);
+    return textureCacheSettings.directory + "/" + name;
+}
+
+std::vector<unsigned char> BuildTextureContainer(uint64_t sourceHash, uint64_t sourceSize, bool alpha, CachedFormat format, const std::vector<MipLevel>& mips) {
+    const size_t tableOffset = sizeof(CachedTextureHeader);
+    size_t dataOffset = AlignUp(tableOffset + sizeof(CachedMipEntry) * mips.size(), 16);
+
+    std::vector<CachedMipEntry> table(mips.size());
+    size_t total = dataOffset;
+    for (size_t i = 0; i < mips.size(); i++) {
+        table[i].width = (uint32_t)mips[i].width;
+        table[i].height = (uint32_t)mips[i].height;
+        table[i].offset = total;
+        table[i].size = LevelBytes(format, mips[i].width, mips[i].height);
+        total = AlignUp(total + table[i].size, 16);
+    }
+
+    std::vector<unsigned char> bytes(total, 0);
+
+    CachedTextureHeader header{};
+    std::memcpy(header.magic, "PTXC", 4);
+    header.version = kCacheVersion;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+    header.width = (uint32_t)mips[0].width;
+    header.height = (uint32_t)mips[0].height;
+    header.levels = (uint32_t)mips.size();
+    header.format = (uint32_t)format;
+    header.alpha = alpha ? 1u : 0u;
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + tableOffset, table.data(), sizeof(CachedMipEntry) * table.size());
+
+    std::vector<unsigned char> blocks;
+    for (size_t i = 0; i < mips.size(); i++) {
+        if (format == CachedFormat::RGBA8) {
+            std::memcpy(bytes.data() + table[i].offset, mips[i].pixels.data(), table[i].size);
+        } else {
+            CompressBC(mips[i], format, blocks);
+            std::memcpy(bytes.data() + table[i].offset, blocks.data(), table[i].size);
+        }
+    }
+    return bytes;
+}
+
+bool CachedTexture::validate(size_t size) {
+    if (size < sizeof(CachedTextureHeader)) return false;
+    const CachedTextureHeader& h = header();
+    if (std::memcmp(h.magic, "PTXC", 4) != 0 || h.version != kCacheVersion) return false;
+    if (h.format > (uint32_t)CachedFormat::BC3 || h.levels == 0 || h.levels > 32) return false;
+    if (sizeof(CachedTextureHeader) + sizeof(CachedMipEntry) * h.levels > size) return false;
+
+    mipTable = reinterpret_cast<const CachedMipEntry*>(base + sizeof(CachedTextureHeader));
+    for (uint32_t i = 0; i < h.levels; i++) {
+        const CachedMipEntry& m = mipTable[i];
+        if (m.offset > size || m.size > size - m.offset) return false;
+        if (m.size != LevelBytes((CachedFormat)h.format, (int)m.width, (int)m.height)) return false;
+    }
+    return true;
+}
+
+bool CachedTexture::open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, bool alpha, CachedFormat format) {
+    close();
+    if (!file.open(path)) return false;
+    base = file.data;
+
+    bool ok = validate(file.size)
+        && header().sourceHash == sourceHash
+        && header().sourceSize == sourceSize
+        && header().format == (uint32_t)format
+        && header().alpha == (alpha ? 1u : 0u);
+    if (!ok) close();
+    return ok;
+}
+
+bool CachedTexture::adopt(std::vector<unsigned char>&& bytes) {
+    close();
+    memory = std::move(bytes);
+    base = memory.data();
+    if (!validate(memory.size())) { close(); return false; }
+    return true;
+}
+
+void CachedTexture::close() {
+    file.close();
+    memory.clear();
+    memory.shrink_to_fit();
+    base = nullptr;
+    mipTable = nullptr;
+}
+
+GLenum CachedTexture::internalFormat() const {
+    switch ((CachedFormat)header().format) {
+        case CachedFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case CachedFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        default: return header().alpha ? GL_RGBA8 : GL_RGB8;
+    }
+}
+
+bool LoadTextureCached(const std::string& sourcePath, bool alpha, CachedTexture& out) {
+    MappedFile source;
+    if (!source.open(sourcePath)) return false;
+
+    const uint64_t hash = HashBytes(source.data, source.size);
+    const CachedFormat format = PreferredCacheFormat(alpha);
+    const std::string cachePath = TextureCachePath(hash, alpha, format);
+
+    if (textureCacheSettings.enabled && out.open(cachePath, hash, source.size, alpha, format)) return true;
+
+    // Промах: декодируем прямо из отображённого файла
+    stbi_set_flip_vertically_on_load_thread(1);
+    int w, h, ch;
+    unsigned char* data = stbi_load_from_memory(source.data, (int)source.size, &w, &h, &ch, 4);
+    if (!data) return false;
+    std::vector<MipLevel> mips = BuildMipChain(data, w, h);
+    stbi_image_free(data);
+
+    std::vector<unsigned char> bytes = BuildTextureContainer(hash, source.size, alpha, format, mips);
+    mips.clear();
+
+    if (textureCacheSettings.enabled) {
+        // Пишем во временный файл и переименовываем, чтобы параллельный запуск не увидел полузаписанный кэш
+        std::error_code ec;
+        std::filesystem::create_directories(textureCacheSettings.directory, ec);
+        std::string tmpPath = cachePath + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        {
+            std::ofstream f(tmpPath, std::ios::binary | std::ios::trunc);
+            if (f) f.write(reinterpret_cast<const char*>(bytes.data()), (std::streamsize)bytes.size());
+        }
+        std::filesystem::rename(tmpPath, cachePath, ec);
+        if (ec) {
+            std::filesystem::remove(tmpPath, ec);
+        } else if (out.open(cachePath, hash, source.size, alpha, format)) {
+            return true;
+        }
+    }
+    return out.adopt(std::move(bytes));
+}